@@ -1,4 +1,5 @@
 #include "numtheory.h"
+#include "profile.h"
 #include "randstate.h"
 #include "rsa.h"
 
@@ -15,7 +16,7 @@
 
 #include <gmp.h>
 
-#define OPTIONS "i:o:n:vh"
+#define OPTIONS "i:o:n:pjcvh"
 
 void help_message(void) {
     fprintf(stderr, "SYNOPSIS\n"
@@ -23,14 +24,17 @@ void help_message(void) {
                     "   Encrypted data is encrypted by the encrypt program.\n"
                     "\n"
                     "USAGE\n"
-                    "   ./decrypt [-hv] [-i infile] [-o outfile] -n privkey\n"
+                    "   ./decrypt [-hvpjc] [-i infile] [-o outfile] -n privkey\n"
                     "\n"
                     "OPTIONS\n"
                     "   -h              Display program help and usage.\n"
                     "   -v              Display verbose program output.\n"
                     "   -i infile       Input file of data to decrypt (default: stdin).\n"
                     "   -o outfile      Output file for decrypted data (default: stdout).\n"
-                    "   -n pvfile       Private key file (default: rsa.priv).\n");
+                    "   -n pvfile       Private key file (default: rsa.priv).\n"
+                    "   -p              Print a profile of where the time went to stderr.\n"
+                    "   -j              Print the profile as JSON (implies -p).\n"
+                    "   -c              Add CPU cycle and instruction counts to the profile (implies -p).\n");
 }
 
 int main(int argc, char **argv) {
@@ -40,6 +44,9 @@ int main(int argc, char **argv) {
     char *pvname = "rsa.priv";
     FILE *pvfile;
     bool verbose = false;
+    bool profiling = false;
+    bool json = false;
+    bool counters = false;
 
     // Parsing command-line options using getopt() and handling them accordingly.
     while ((opt = getopt(argc, argv, OPTIONS)) != -1) {
@@ -57,6 +64,15 @@ int main(int argc, char **argv) {
             }
             break;
         case 'n': pvname = optarg; break;
+        case 'p': profiling = true; break;
+        case 'j':
+            profiling = true;
+            json = true;
+            break;
+        case 'c':
+            profiling = true;
+            counters = true;
+            break;
         case 'v': verbose = true; break;
         case 'h': help_message(); return EXIT_SUCCESS;
         default: help_message(); return EXIT_FAILURE;
@@ -86,8 +102,13 @@ int main(int argc, char **argv) {
         gmp_printf("d (%d bits) = %Zd\n", mpz_sizeinbase(d, 2), d);
     }
 
-    // Decrypting the file using rsa_decrypt_file().
-    rsa_decrypt_file(infile, outfile, n, d);
+    // Decrypting the file using rsa_decrypt_file(), profiling it if requested.
+    if (profiling) {
+        profile_init(counters);
+    }
+    bool ok = rsa_decrypt_file(infile, outfile, n, d);
+    profile_print(stderr, json);
+    profile_clear();
 
     // Closing infile, outfile, and the private key file.
     fclose(infile);
@@ -97,5 +118,5 @@ int main(int argc, char **argv) {
     mpz_clear(n);
     mpz_clear(d);
 
-    return EXIT_SUCCESS;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -1,4 +1,5 @@
 #include "numtheory.h"
+#include "profile.h"
 #include "randstate.h"
 #include "rsa.h"
 
@@ -15,7 +16,7 @@
 
 #include <gmp.h>
 
-#define OPTIONS "i:o:n:vh"
+#define OPTIONS "i:o:n:zpjcvh"
 
 void help_message(void) {
     fprintf(stderr, "SYNOPSIS\n"
@@ -23,25 +24,37 @@ void help_message(void) {
                     "   Encrypted data is decrypted by the decrypt program.\n"
                     "\n"
                     "USAGE\n"
-                    "   ./encrypt [-hv] [-i infile] [-o outfile] -n pubkey\n"
+                    "   ./encrypt [-hvzpjc] [-i infile] [-o outfile] -n pubkey [-o outfile -n pubkey]...\n"
                     "\n"
                     "OPTIONS\n"
                     "   -h              Display program help and usage.\n"
                     "   -v              Display verbose program output.\n"
                     "   -i infile       Input file of data to encrypt (default: stdin).\n"
                     "   -o outfile      Output file for encrypted data (default: stdout).\n"
-                    "   -n pbfile       Public key file (default: rsa.pub).\n");
+                    "   -n pbfile       Public key file (default: rsa.pub). Repeat -n and -o to encrypt\n"
+                    "                   for several recipients in one pass over the input.\n"
+                    "   -z              Compress the data before encrypting it.\n"
+                    "   -p              Print a profile of where the time went to stderr.\n"
+                    "   -j              Print the profile as JSON (implies -p).\n"
+                    "   -c              Add CPU cycle and instruction counts to the profile (implies -p).\n");
 }
 
 int main(int argc, char **argv) {
     int opt = 0;
     FILE *infile = stdin;
-    FILE *outfile = stdout;
-    char *pbname = "rsa.pub";
+    FILE **outfiles = (FILE **) calloc(argc, sizeof(FILE *));
+    size_t num_outfiles = 0;
+    char **pbnames = (char **) calloc(argc, sizeof(char *));
+    size_t count = 0;
     FILE *pbfile;
     bool verbose = false;
+    bool compress = false;
+    bool profiling = false;
+    bool json = false;
+    bool counters = false;
 
-    // Parsing command-line options using getopt() and handling them accordingly.
+    // Parsing command-line options using getopt() and handling them accordingly. Every -n adds a recipient,
+    // and the recipients' outfiles are given with -o in the same order.
     while ((opt = getopt(argc, argv, OPTIONS)) != -1) {
         switch (opt) {
         case 'i':
@@ -51,75 +64,113 @@ int main(int argc, char **argv) {
             }
             break;
         case 'o':
-            if ((outfile = fopen(optarg, "w")) == NULL) {
+            if ((outfiles[num_outfiles++] = fopen(optarg, "w")) == NULL) {
                 fprintf(stderr, "%s: No such file or directory\n", optarg);
                 return EXIT_FAILURE;
             }
             break;
-        case 'n': pbname = optarg; break;
+        case 'n': pbnames[count++] = optarg; break;
+        case 'z': compress = true; break;
+        case 'p': profiling = true; break;
+        case 'j':
+            profiling = true;
+            json = true;
+            break;
+        case 'c':
+            profiling = true;
+            counters = true;
+            break;
         case 'v': verbose = true; break;
         case 'h': help_message(); return EXIT_SUCCESS;
         default: help_message(); return EXIT_FAILURE;
         }
     }
 
-    // Opening the public key file using fopen(). Printing a helpful error and exiting the program in the event
-    // of failure.
-    pbfile = fopen(pbname, "r");
-    if (pbfile == NULL) {
-        fprintf(stderr, "%s: No such file or directory\n", pbname);
+    // Defaulting to a single recipient with rsa.pub, and to stdout for a single recipient's outfile. Several
+    // recipients each need their own outfile.
+    if (count == 0) {
+        pbnames[count++] = "rsa.pub";
+    }
+    if (count == 1 && num_outfiles == 0) {
+        outfiles[num_outfiles++] = stdout;
+    }
+    if (num_outfiles != count) {
+        fprintf(stderr, "Error: each public key file needs its own output file.\n");
+        help_message();
         return EXIT_FAILURE;
     }
 
-    mpz_t n;
-    mpz_init(n);
-    mpz_t e;
-    mpz_init(e);
+    mpz_t *n = (mpz_t *) calloc(count, sizeof(mpz_t));
+    mpz_t *e = (mpz_t *) calloc(count, sizeof(mpz_t));
     mpz_t s;
     mpz_init(s);
     mpz_t m;
     mpz_init(m);
     char username[256];
+    bool verified = true;
 
-    // Reading the public key from the opened public key file.
-    rsa_read_pub(n, e, s, username, pbfile);
+    for (size_t i = 0; i < count && verified; i++) {
+        mpz_init(n[i]);
+        mpz_init(e[i]);
 
-    // If verbose output is enabled, print the username, the signature s, the public modulus n, and the
-    // public exponent e each with a trailing newline.
-    if (verbose) {
-        printf("user = %s\n", username);
-        gmp_printf("s (%d bits) = %Zd\n", mpz_sizeinbase(s, 2), s);
-        gmp_printf("n (%d bits) = %Zd\n", mpz_sizeinbase(n, 2), n);
-        gmp_printf("e (%d bits) = %Zd\n", mpz_sizeinbase(e, 2), e);
-    }
+        // Opening the public key file using fopen(). Printing a helpful error and exiting the program in the
+        // event of failure.
+        pbfile = fopen(pbnames[i], "r");
+        if (pbfile == NULL) {
+            fprintf(stderr, "%s: No such file or directory\n", pbnames[i]);
+            return EXIT_FAILURE;
+        }
 
-    // Converting the username that was read in to an mpz_t.
-    mpz_set_str(m, username, 62);
-    // Verifying the signature. If the signature couldn't be verified, report an error and exit the program.
-    if (rsa_verify(m, s, e, n) == false) {
-        fprintf(stderr, "Error: the signature was not verified.\n");
-        fclose(infile);
-        fclose(outfile);
+        // Reading the public key from the opened public key file.
+        rsa_read_pub(n[i], e[i], s, username, pbfile);
         fclose(pbfile);
-        mpz_clear(n);
-        mpz_clear(e);
-        mpz_clear(s);
-        mpz_clear(m);
-        return EXIT_FAILURE;
+
+        // If verbose output is enabled, print the username, the signature s, the public modulus n, and the
+        // public exponent e each with a trailing newline.
+        if (verbose) {
+            printf("user = %s\n", username);
+            gmp_printf("s (%d bits) = %Zd\n", mpz_sizeinbase(s, 2), s);
+            gmp_printf("n (%d bits) = %Zd\n", mpz_sizeinbase(n[i], 2), n[i]);
+            gmp_printf("e (%d bits) = %Zd\n", mpz_sizeinbase(e[i], 2), e[i]);
+        }
+
+        // Converting the username that was read in to an mpz_t.
+        mpz_set_str(m, username, 62);
+        // Verifying the signature. If the signature couldn't be verified, report an error and stop.
+        if (rsa_verify(m, s, e[i], n[i]) == false) {
+            fprintf(stderr, "Error: the signature was not verified.\n");
+            verified = false;
+            count = i + 1;
+        }
     }
 
-    // Encrypting the file using rsa_encrypt_file().
-    rsa_encrypt_file(infile, outfile, n, e);
+    // Encrypting the file once for every recipient using rsa_encrypt_file_multi(), compressing and profiling it
+    // if requested.
+    if (verified) {
+        if (profiling) {
+            profile_init(counters);
+        }
+        rsa_encrypt_file_multi(infile, outfiles, n, e, count, compress);
+        profile_print(stderr, json);
+        profile_clear();
+    }
 
-    // Closing infile, outfile, and the public key file.
+    // Closing infile and the outfiles.
     fclose(infile);
-    fclose(outfile);
-    fclose(pbfile);
+    for (size_t i = 0; i < num_outfiles; i++) {
+        fclose(outfiles[i]);
+    }
     // Clearing all the mpz_t variables used in the program.
-    mpz_clear(n);
-    mpz_clear(e);
+    for (size_t i = 0; i < count; i++) {
+        mpz_clear(n[i]);
+        mpz_clear(e[i]);
+    }
     mpz_clear(s);
     mpz_clear(m);
+    free(n);
+    free(e);
+    free(outfiles);
+    free(pbnames);
 
-    return EXIT_SUCCESS;
+    return verified ? EXIT_SUCCESS : EXIT_FAILURE;
 }
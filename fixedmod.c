@@ -0,0 +1,128 @@
+#include "fixedmod.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <gmp.h>
+
+// Number of limbs needed to hold a modulus of the given bits.
+#define FIXED_LIMBS(bits) ((bits) / GMP_NUMB_BITS)
+
+// Bits of the exponent consumed per table lookup in the windowed exponentiation.
+#define WINDOW_BITS 4
+
+// This function computes -n0^-1 modulo 2^GMP_NUMB_BITS with Newton's iteration, which doubles the number of
+// correct low bits on each step starting from the 3 bits that every odd n0 is its own inverse for.
+// This function takes in as a parameter mp_limb_t n0 which is the odd low limb of the modulus.
+// This function returns the negated inverse used by the Montgomery reduction.
+static mp_limb_t limb_inverse(mp_limb_t n0) {
+    mp_limb_t x = n0;
+    for (int bits = 3; bits < GMP_NUMB_BITS; bits *= 2) {
+        x *= 2 - n0 * x;
+    }
+    return -x;
+}
+
+// This macro defines fixed_pow_mod_NAME(), a modular exponentiation kernel for moduli of exactly LIMBS limbs.
+// Every operand lives in a stack array of LIMBS limbs and every loop bound is the compile time constant LIMBS,
+// so nothing is allocated on the heap and the compiler is free to unroll the multiply and reduce loops. The
+// limb products themselves are done by GMP's mpn routines. Values are kept in Montgomery form, x * R mod n
+// with R = 2^(LIMBS * GMP_NUMB_BITS), and the exponent is scanned WINDOW_BITS bits at a time.
+#define DEFINE_FIXED_POW_MOD(NAME, LIMBS)                                                                      \
+    static void mont_mul_##NAME(mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b, const mp_limb_t *n,      \
+        mp_limb_t ninv) {                                                                                      \
+        mp_limb_t t[2 * (LIMBS)];                                                                              \
+        if (a == b) {                                                                                          \
+            mpn_sqr(t, a, LIMBS);                                                                              \
+        } else {                                                                                               \
+            mpn_mul_n(t, a, b, LIMBS);                                                                         \
+        }                                                                                                      \
+        mp_limb_t carry = 0;                                                                                   \
+        for (int i = 0; i < (LIMBS); i++) {                                                                    \
+            mp_limb_t c = mpn_addmul_1(t + i, n, LIMBS, t[i] * ninv);                                          \
+            carry += mpn_add_1(t + i + (LIMBS), t + i + (LIMBS), (LIMBS) - i, c);                              \
+        }                                                                                                      \
+        if (carry != 0 || mpn_cmp(t + (LIMBS), n, LIMBS) >= 0) {                                               \
+            mpn_sub_n(r, t + (LIMBS), n, LIMBS);                                                               \
+        } else {                                                                                               \
+            mpn_copyi(r, t + (LIMBS), LIMBS);                                                                  \
+        }                                                                                                      \
+    }                                                                                                          \
+                                                                                                               \
+    static void fixed_pow_mod_##NAME(mpz_t out, mpz_t base, mpz_t exponent, mpz_t modulus) {                   \
+        mp_limb_t n[LIMBS] = { 0 };                                                                            \
+        mp_limb_t x[LIMBS] = { 0 };                                                                            \
+        mp_limb_t r2[LIMBS] = { 0 };                                                                           \
+        mp_limb_t one[LIMBS] = { 1 };                                                                          \
+        mp_limb_t table[1 << WINDOW_BITS][LIMBS];                                                              \
+        mp_limb_t big[2 * (LIMBS) + 1] = { 0 };                                                                \
+        mp_limb_t quotient[2 * (LIMBS) + 2];                                                                   \
+        size_t nsize = mpz_size(modulus);                                                                      \
+        mpn_copyi(n, mpz_limbs_read(modulus), nsize);                                                          \
+        mpn_copyi(x, mpz_limbs_read(base), mpz_size(base));                                                    \
+        mp_limb_t ninv = limb_inverse(n[0]);                                                                   \
+                                                                                                               \
+        big[2 * (LIMBS)] = 1;                                                                                  \
+        mpn_tdiv_qr(quotient, r2, 0, big, 2 * (LIMBS) + 1, n, nsize);                                          \
+                                                                                                               \
+        mont_mul_##NAME(table[0], r2, one, n, ninv);                                                           \
+        mont_mul_##NAME(table[1], x, r2, n, ninv);                                                             \
+        for (int i = 2; i < (1 << WINDOW_BITS); i++) {                                                         \
+            mont_mul_##NAME(table[i], table[i - 1], table[1], n, ninv);                                        \
+        }                                                                                                      \
+                                                                                                               \
+        mpn_copyi(x, table[0], LIMBS);                                                                         \
+        size_t windows = (mpz_sizeinbase(exponent, 2) + WINDOW_BITS - 1) / WINDOW_BITS;                        \
+        for (size_t w = windows; w > 0; w--) {                                                                 \
+            unsigned int digit = 0;                                                                            \
+            for (int b = WINDOW_BITS - 1; b >= 0; b--) {                                                       \
+                mont_mul_##NAME(x, x, x, n, ninv);                                                             \
+                digit = (digit << 1) | mpz_tstbit(exponent, (w - 1) * WINDOW_BITS + b);                        \
+            }                                                                                                  \
+            if (digit != 0) {                                                                                  \
+                mont_mul_##NAME(x, x, table[digit], n, ninv);                                                  \
+            }                                                                                                  \
+        }                                                                                                      \
+        mont_mul_##NAME(x, x, one, n, ninv);                                                                   \
+                                                                                                               \
+        mpn_copyi(mpz_limbs_write(out, LIMBS), x, LIMBS);                                                      \
+        mpz_limbs_finish(out, LIMBS);                                                                          \
+    }
+
+// keygen -b bits makes moduli a bit or two longer than bits, so each key size also gets a kernel one limb
+// wider than the exact width.
+DEFINE_FIXED_POW_MOD(2048, FIXED_LIMBS(2048))
+DEFINE_FIXED_POW_MOD(2048_wide, FIXED_LIMBS(2048) + 1)
+DEFINE_FIXED_POW_MOD(3072, FIXED_LIMBS(3072))
+DEFINE_FIXED_POW_MOD(3072_wide, FIXED_LIMBS(3072) + 1)
+DEFINE_FIXED_POW_MOD(4096, FIXED_LIMBS(4096))
+DEFINE_FIXED_POW_MOD(4096_wide, FIXED_LIMBS(4096) + 1)
+
+static const struct {
+    size_t limbs;
+    void (*pow_mod)(mpz_t out, mpz_t base, mpz_t exponent, mpz_t modulus);
+} kernels[] = {
+    { FIXED_LIMBS(2048), fixed_pow_mod_2048 },
+    { FIXED_LIMBS(2048) + 1, fixed_pow_mod_2048_wide },
+    { FIXED_LIMBS(3072), fixed_pow_mod_3072 },
+    { FIXED_LIMBS(3072) + 1, fixed_pow_mod_3072_wide },
+    { FIXED_LIMBS(4096), fixed_pow_mod_4096 },
+    { FIXED_LIMBS(4096) + 1, fixed_pow_mod_4096_wide },
+};
+
+// This function computes base raised to the exponent power modulo modulus with the fixed width kernel that
+// matches the size of modulus, storing the computed result in out.
+// This function takes in as parameters mpz_t out, mpz_t base, mpz_t exponent, and mpz_t modulus.
+// This function returns true if a kernel was used, and false if there is no kernel for the size of modulus or
+// the operands are out of its range, in which case out is left untouched and pow_mod() should be used instead.
+bool fixed_pow_mod(mpz_t out, mpz_t base, mpz_t exponent, mpz_t modulus) {
+    if (mpz_even_p(modulus) || mpz_sgn(base) < 0 || mpz_sgn(exponent) < 0 || mpz_cmp(base, modulus) >= 0) {
+        return false;
+    }
+    for (size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++) {
+        if (kernels[i].limbs == mpz_size(modulus)) {
+            kernels[i].pow_mod(out, base, exponent, modulus);
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdbool.h>
+#include <gmp.h>
+
+bool fixed_pow_mod(mpz_t out, mpz_t base, mpz_t exponent, mpz_t modulus);
@@ -0,0 +1,361 @@
+#include "hex.h"
+#include <ctype.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gmp.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define HEX_X86 1
+#endif
+
+// Values of up to this many bytes are converted in stack buffers, which covers every key size in use. Larger
+// values fall back to the heap.
+#define STACK_BYTES 1024
+
+static const char digits[16] = "0123456789abcdef";
+
+// This function encodes len bytes as 2 * len lowercase hex digits, one byte at a time.
+// This function takes in as parameters char *out, const uint8_t *in, and size_t len.
+static void encode_scalar(char *out, const uint8_t *in, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        out[2 * i] = digits[in[i] >> 4];
+        out[2 * i + 1] = digits[in[i] & 15];
+    }
+}
+
+// This function converts one hex digit, upper or lower case, to its value.
+// This function takes in as a parameter char c.
+// This function returns the value of the digit, or -1 if c is not a hex digit.
+static int digit_value(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+        return (c | 0x20) - 'a' + 10;
+    }
+    return -1;
+}
+
+// This function decodes 2 * len hex digits into len bytes, one byte at a time.
+// This function takes in as parameters uint8_t *out, const char *in, and size_t len which is the number of
+// bytes.
+// This function returns false if a character is not a hex digit.
+static bool decode_scalar(uint8_t *out, const char *in, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        int hi = digit_value(in[2 * i]);
+        int lo = digit_value(in[2 * i + 1]);
+        if (hi < 0 || lo < 0) {
+            return false;
+        }
+        out[i] = (uint8_t) (hi << 4 | lo);
+    }
+    return true;
+}
+
+#ifdef HEX_X86
+// This function encodes 16 bytes at a time with SSSE3, looking both nibbles of every byte up in the digit
+// table with a byte shuffle and interleaving them, and encodes the rest one byte at a time.
+// This function takes in as parameters char *out, const uint8_t *in, and size_t len.
+__attribute__((target("ssse3"))) static void encode_ssse3(char *out, const uint8_t *in, size_t len) {
+    const __m128i table = _mm_loadu_si128((const __m128i *) digits);
+    const __m128i mask = _mm_set1_epi8(15);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (in + i));
+        __m128i hi = _mm_shuffle_epi8(table, _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+        __m128i lo = _mm_shuffle_epi8(table, _mm_and_si128(v, mask));
+        _mm_storeu_si128((__m128i *) (out + 2 * i), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i *) (out + 2 * i + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+    encode_scalar(out + 2 * i, in + i, len - i);
+}
+
+// This function encodes 32 bytes at a time with AVX2 like encode_ssse3(). The interleaving works within each
+// 128 bit lane, so the lanes are put back in order before storing.
+// This function takes in as parameters char *out, const uint8_t *in, and size_t len.
+__attribute__((target("avx2"))) static void encode_avx2(char *out, const uint8_t *in, size_t len) {
+    const __m256i table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) digits));
+    const __m256i mask = _mm256_set1_epi8(15);
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (in + i));
+        __m256i hi = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(v, 4), mask));
+        __m256i lo = _mm256_shuffle_epi8(table, _mm256_and_si256(v, mask));
+        __m256i first = _mm256_unpacklo_epi8(hi, lo);
+        __m256i second = _mm256_unpackhi_epi8(hi, lo);
+        _mm256_storeu_si256((__m256i *) (out + 2 * i), _mm256_permute2x128_si256(first, second, 0x20));
+        _mm256_storeu_si256((__m256i *) (out + 2 * i + 32), _mm256_permute2x128_si256(first, second, 0x31));
+    }
+    encode_ssse3(out + 2 * i, in + i, len - i);
+}
+
+// This function converts 16 hex digits to their values with SSSE3, flagging any character that is not a hex
+// digit. Bytes of 0x80 and up compare as negative, so they are never taken for digits.
+// This function takes in as parameters __m128i c which holds the characters and __m128i *valid which is set
+// to all ones for every character that is a hex digit.
+// This function returns the values of the digits.
+__attribute__((target("ssse3"))) static __m128i values_ssse3(__m128i c, __m128i *valid) {
+    __m128i lower = _mm_or_si128(c, _mm_set1_epi8(0x20));
+    __m128i is_digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+    __m128i is_letter = _mm_and_si128(
+        _mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+    *valid = _mm_or_si128(is_digit, is_letter);
+    return _mm_or_si128(_mm_and_si128(is_digit, _mm_sub_epi8(c, _mm_set1_epi8('0'))),
+        _mm_and_si128(is_letter, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10))));
+}
+
+// This function decodes 32 hex digits into 16 bytes at a time with SSSE3, joining every pair of digit values
+// with a multiply-add, and decodes the rest one byte at a time.
+// This function takes in as parameters uint8_t *out, const char *in, and size_t len which is the number of
+// bytes.
+// This function returns false if a character is not a hex digit.
+__attribute__((target("ssse3"))) static bool decode_ssse3(uint8_t *out, const char *in, size_t len) {
+    const __m128i weights = _mm_set1_epi16(0x0110);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i valid_first;
+        __m128i valid_second;
+        __m128i first = values_ssse3(_mm_loadu_si128((const __m128i *) (in + 2 * i)), &valid_first);
+        __m128i second = values_ssse3(_mm_loadu_si128((const __m128i *) (in + 2 * i + 16)), &valid_second);
+        if (_mm_movemask_epi8(_mm_and_si128(valid_first, valid_second)) != 0xFFFF) {
+            return false;
+        }
+        __m128i bytes = _mm_packus_epi16(_mm_maddubs_epi16(first, weights), _mm_maddubs_epi16(second, weights));
+        _mm_storeu_si128((__m128i *) (out + i), bytes);
+    }
+    return decode_scalar(out + i, in + 2 * i, len - i);
+}
+
+// This function converts 32 hex digits to their values with AVX2 like values_ssse3().
+// This function takes in as parameters __m256i c and __m256i *valid.
+// This function returns the values of the digits.
+__attribute__((target("avx2"))) static __m256i values_avx2(__m256i c, __m256i *valid) {
+    __m256i lower = _mm256_or_si256(c, _mm256_set1_epi8(0x20));
+    __m256i is_digit = _mm256_andnot_si256(
+        _mm256_cmpgt_epi8(c, _mm256_set1_epi8('9')), _mm256_cmpgt_epi8(c, _mm256_set1_epi8('0' - 1)));
+    __m256i is_letter = _mm256_andnot_si256(
+        _mm256_cmpgt_epi8(lower, _mm256_set1_epi8('f')), _mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)));
+    *valid = _mm256_or_si256(is_digit, is_letter);
+    return _mm256_or_si256(_mm256_and_si256(is_digit, _mm256_sub_epi8(c, _mm256_set1_epi8('0'))),
+        _mm256_and_si256(is_letter, _mm256_sub_epi8(lower, _mm256_set1_epi8('a' - 10))));
+}
+
+// This function decodes 64 hex digits into 32 bytes at a time with AVX2 like decode_ssse3(). The packing works
+// within each 128 bit lane, so the quarters are put back in order before storing.
+// This function takes in as parameters uint8_t *out, const char *in, and size_t len which is the number of
+// bytes.
+// This function returns false if a character is not a hex digit.
+__attribute__((target("avx2"))) static bool decode_avx2(uint8_t *out, const char *in, size_t len) {
+    const __m256i weights = _mm256_set1_epi16(0x0110);
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i valid_first;
+        __m256i valid_second;
+        __m256i first = values_avx2(_mm256_loadu_si256((const __m256i *) (in + 2 * i)), &valid_first);
+        __m256i second = values_avx2(_mm256_loadu_si256((const __m256i *) (in + 2 * i + 32)), &valid_second);
+        if (_mm256_movemask_epi8(_mm256_and_si256(valid_first, valid_second)) != -1) {
+            return false;
+        }
+        __m256i bytes
+            = _mm256_packus_epi16(_mm256_maddubs_epi16(first, weights), _mm256_maddubs_epi16(second, weights));
+        _mm256_storeu_si256((__m256i *) (out + i), _mm256_permute4x64_epi64(bytes, 0xD8));
+    }
+    return decode_ssse3(out + i, in + 2 * i, len - i);
+}
+#endif
+
+// This function encodes len bytes as 2 * len lowercase hex digits, using the widest vector instructions the
+// CPU supports.
+// This function takes in as parameters char *out, const uint8_t *in, and size_t len.
+void hex_encode(char *out, const uint8_t *in, size_t len) {
+#ifdef HEX_X86
+    if (__builtin_cpu_supports("avx2")) {
+        encode_avx2(out, in, len);
+        return;
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        encode_ssse3(out, in, len);
+        return;
+    }
+#endif
+    encode_scalar(out, in, len);
+}
+
+// This function decodes 2 * len hex digits, upper or lower case, into len bytes, using the widest vector
+// instructions the CPU supports.
+// This function takes in as parameters uint8_t *out, const char *in, and size_t len which is the number of
+// bytes.
+// This function returns false if a character is not a hex digit.
+bool hex_decode(uint8_t *out, const char *in, size_t len) {
+#ifdef HEX_X86
+    if (__builtin_cpu_supports("avx2")) {
+        return decode_avx2(out, in, len);
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return decode_ssse3(out, in, len);
+    }
+#endif
+    return decode_scalar(out, in, len);
+}
+
+// This function lays the limbs of the magnitude of x out as big endian bytes, which is what mpz_export()
+// does one byte at a time.
+// This function takes in as parameters uint8_t *out which must hold mpz_size(x) limbs, and mpz_t x.
+// This function returns the number of bytes written, which includes any leading zero bytes of the top limb.
+static size_t limbs_to_bytes(uint8_t *out, mpz_t x) {
+    size_t size = mpz_size(x);
+    const mp_limb_t *limbs = mpz_limbs_read(x);
+    for (size_t i = 0; i < size; i++) {
+        mp_limb_t limb = limbs[size - 1 - i];
+        for (size_t b = 0; b < sizeof(mp_limb_t); b++) {
+            out[i * sizeof(mp_limb_t) + b] = (uint8_t) (limb >> (8 * (sizeof(mp_limb_t) - 1 - b)));
+        }
+    }
+    return size * sizeof(mp_limb_t);
+}
+
+// This function sets x to the big endian bytes in, writing its limbs directly instead of going through
+// mpz_import().
+// This function takes in as parameters mpz_t x, const uint8_t *in, and size_t len.
+static void bytes_to_limbs(mpz_t x, const uint8_t *in, size_t len) {
+    size_t size = (len + sizeof(mp_limb_t) - 1) / sizeof(mp_limb_t);
+    if (size == 0) {
+        mpz_set_ui(x, 0);
+        return;
+    }
+    mp_limb_t *limbs = mpz_limbs_write(x, size);
+    memset(limbs, 0, size * sizeof(mp_limb_t));
+    for (size_t j = 0; j < len; j++) {
+        limbs[j / sizeof(mp_limb_t)] |= (mp_limb_t) in[len - 1 - j] << (8 * (j % sizeof(mp_limb_t)));
+    }
+    mpz_limbs_finish(x, size);
+}
+
+// This function writes x to outfile in hexadecimal followed by a newline, exactly as
+// gmp_fprintf(outfile, "%Zx\n", x) would.
+// This function takes in as parameters FILE *outfile and mpz_t x.
+void hex_write(FILE *outfile, mpz_t x) {
+    uint8_t stack_bytes[STACK_BYTES];
+    char stack_chars[2 * STACK_BYTES + 2];
+    size_t len = mpz_size(x) * sizeof(mp_limb_t);
+    uint8_t *bytes = len <= STACK_BYTES ? stack_bytes : (uint8_t *) malloc(len);
+    char *chars = len <= STACK_BYTES ? stack_chars : (char *) malloc(2 * len + 2);
+
+    size_t count = limbs_to_bytes(bytes, x);
+    size_t skip = 0;
+    while (skip < count && bytes[skip] == 0) {
+        skip++;
+    }
+    count -= skip;
+    char *start = chars + 1;
+    if (count == 0) {
+        *start = '0';
+        count = 1;
+    } else {
+        hex_encode(start, bytes + skip, count);
+        count *= 2;
+        if (*start == '0') {
+            start++;
+            count--;
+        }
+    }
+    if (mpz_sgn(x) < 0) {
+        *--start = '-';
+        count++;
+    }
+    start[count++] = '\n';
+    fwrite(start, sizeof(char), count, outfile);
+
+    if (bytes != stack_bytes) {
+        free(bytes);
+        free(chars);
+    }
+}
+
+// This function skips past any whitespace in infile.
+// This function takes in as a parameter FILE *infile.
+static void skip_space(FILE *infile) {
+    int c;
+    while ((c = getc(infile)) != EOF && isspace(c)) {
+    }
+    if (c != EOF) {
+        ungetc(c, infile);
+    }
+}
+
+// This function skips whitespace in infile and reports whether anything is left to read, so that callers of
+// hex_read() can tell the end of the input apart from a line that is not a hexadecimal number.
+// This function takes in as a parameter FILE *infile.
+// This function returns true if infile has more input.
+bool hex_more(FILE *infile) {
+    skip_space(infile);
+    int c = getc(infile);
+    if (c == EOF) {
+        return false;
+    }
+    ungetc(c, infile);
+    return true;
+}
+
+// This function reads a hexadecimal number and the whitespace after it from infile into x, accepting what
+// gmp_fscanf(infile, "%Zx\n", x) would for the files this program writes: one number per line.
+// This function takes in as parameters FILE *infile and mpz_t x.
+// This function returns false if there was no number left to read or the line was not a hexadecimal number,
+// in which case x is left untouched.
+bool hex_read(FILE *infile, mpz_t x) {
+    char stack_line[2 * STACK_BYTES + 4];
+    char *line = stack_line;
+    size_t size = sizeof(stack_line);
+    size_t len = 0;
+
+    skip_space(infile);
+    while (fgets(line + len, (int) (size - len), infile) != NULL) {
+        len += strlen(line + len);
+        if (len > 0 && line[len - 1] == '\n') {
+            break;
+        }
+        size *= 2;
+        line = line == stack_line ? memcpy(malloc(size), stack_line, len) : realloc(line, size);
+    }
+    skip_space(infile);
+
+    while (len > 0 && isspace((unsigned char) line[len - 1])) {
+        len--;
+    }
+    bool negative = len > 0 && line[0] == '-';
+    char *hex = line + negative;
+    len -= negative;
+
+    bool valid = len > 0;
+    if (valid) {
+        size_t bytes_len = (len + 1) / 2;
+        uint8_t stack_bytes[STACK_BYTES + 1];
+        uint8_t *bytes = bytes_len <= sizeof(stack_bytes) ? stack_bytes : (uint8_t *) malloc(bytes_len);
+        size_t odd = len % 2;
+        if (odd) {
+            int value = digit_value(hex[0]);
+            valid = value >= 0;
+            bytes[0] = (uint8_t) value;
+        }
+        valid = valid && hex_decode(bytes + odd, hex + odd, len / 2);
+        if (valid) {
+            bytes_to_limbs(x, bytes, bytes_len);
+            if (negative) {
+                mpz_neg(x, x);
+            }
+        }
+        if (bytes != stack_bytes) {
+            free(bytes);
+        }
+    }
+
+    if (line != stack_line) {
+        free(line);
+    }
+    return valid;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <gmp.h>
+
+void hex_encode(char *out, const uint8_t *in, size_t len);
+
+bool hex_decode(uint8_t *out, const char *in, size_t len);
+
+void hex_write(FILE *outfile, mpz_t x);
+
+bool hex_read(FILE *infile, mpz_t x);
+
+bool hex_more(FILE *infile);
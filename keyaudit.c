@@ -0,0 +1,376 @@
+#include "numtheory.h"
+#include "rsa.h"
+
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <gmp.h>
+
+#define OPTIONS "l:t:d:vh"
+
+void help_message(void) {
+    fprintf(stderr, "SYNOPSIS\n"
+                    "   Audits RSA public keys for moduli that share a prime factor.\n"
+                    "\n"
+                    "USAGE\n"
+                    "   ./keyaudit [-hv] [-t threads] [-d dir] [-l listfile] [pbfile...]\n"
+                    "\n"
+                    "OPTIONS\n"
+                    "   -h              Display program help and usage.\n"
+                    "   -v              Display verbose program output.\n"
+                    "   -l listfile     File listing the public key files to audit, one per line.\n"
+                    "   -t threads      Number of threads working on each tree level (default: 4).\n"
+                    "   -d dir          Directory to spill tree levels to (default: the system's).\n");
+}
+
+// Work on one level of the product or remainder tree, shared by the threads of parallel_for().
+typedef struct {
+    void (*step)(void *ctx, size_t i);
+    void *ctx;
+    size_t count;
+    atomic_size_t next;
+} work;
+
+static size_t threads = 4;
+
+// This function runs the steps of a level, taking the next index that no thread has taken yet until there
+// are none left.
+// This function takes in as a parameter void *arg which is the work, so that it can run as a thread.
+// This function returns NULL.
+static void *worker(void *arg) {
+    work *w = (work *) arg;
+    size_t i;
+    while ((i = atomic_fetch_add(&w->next, 1)) < w->count) {
+        w->step(w->ctx, i);
+    }
+    return NULL;
+}
+
+// This function runs step for every index below count, spread across the threads. If fewer threads could be
+// created than asked for, the steps are shared among those that were, and with none at all they are run on
+// this thread, so that every step runs either way.
+// This function takes in as parameters void (*step)(void *, size_t), void *ctx which is passed to step, and
+// size_t count.
+static void parallel_for(void (*step)(void *ctx, size_t i), void *ctx, size_t count) {
+    work w = { step, ctx, count, 0 };
+    pthread_t *pool = (pthread_t *) calloc(threads, sizeof(pthread_t));
+    size_t started = 0;
+    while (started < threads && pthread_create(&pool[started], NULL, worker, &w) == 0) {
+        started++;
+    }
+    if (started == 0) {
+        worker(&w);
+    }
+    for (size_t t = 0; t < started; t++) {
+        pthread_join(pool[t], NULL);
+    }
+    free(pool);
+}
+
+// A level of the tree: the nodes below, the nodes being computed from them, and the number of each.
+typedef struct {
+    mpz_t *below;
+    size_t below_count;
+    mpz_t *above;
+} tree_level;
+
+// This function computes node i of a product tree level as the product of its two children, or as its only
+// child if it is the odd one out.
+// This function takes in as parameters void *ctx which is the tree_level, and size_t i.
+static void product_step(void *ctx, size_t i) {
+    tree_level *level = (tree_level *) ctx;
+    if (2 * i + 1 < level->below_count) {
+        mpz_mul(level->above[i], level->below[2 * i], level->below[2 * i + 1]);
+    } else {
+        mpz_set(level->above[i], level->below[2 * i]);
+    }
+}
+
+// This function computes remainder i of a remainder tree level as its parent's remainder modulo the square
+// of node i. The nodes are in below and the parents' remainders in above, and the remainder replaces the node.
+// This function takes in as parameters void *ctx which is the tree_level, and size_t i.
+static void remainder_step(void *ctx, size_t i) {
+    tree_level *level = (tree_level *) ctx;
+    mpz_t square;
+    mpz_init(square);
+    mpz_mul(square, level->below[i], level->below[i]);
+    mpz_mod(level->below[i], level->above[i / 2], square);
+    mpz_clear(square);
+}
+
+// This function turns the remainder of the product of all moduli modulo the square of modulus i into the
+// factor that modulus i shares with the others, which is 1 if it shares none.
+// The remainders are in above and the moduli in below, and the factor replaces the remainder.
+// This function takes in as parameters void *ctx which is the tree_level, and size_t i.
+static void factor_step(void *ctx, size_t i) {
+    tree_level *level = (tree_level *) ctx;
+    mpz_tdiv_q(level->above[i], level->above[i], level->below[i]);
+    gcd(level->above[i], level->above[i], level->below[i]);
+}
+
+// This function allocates and initializes count mpz_t.
+// This function takes in as a parameter size_t count.
+// This function returns the array.
+static mpz_t *nodes_init(size_t count) {
+    mpz_t *nodes = (mpz_t *) calloc(count, sizeof(mpz_t));
+    for (size_t i = 0; i < count; i++) {
+        mpz_init(nodes[i]);
+    }
+    return nodes;
+}
+
+// This function clears and frees count mpz_t.
+// This function takes in as parameters mpz_t *nodes and size_t count.
+static void nodes_clear(mpz_t *nodes, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        mpz_clear(nodes[i]);
+    }
+    free(nodes);
+}
+
+// This function opens an anonymous file to spill a tree level to, which disappears once it is closed.
+// This function takes in as a parameter char *dir which is where to put the file, or NULL for tmpfile()'s
+// default.
+// This function returns the opened file, or NULL on failure.
+static FILE *spill_open(char *dir) {
+    if (dir == NULL) {
+        return tmpfile();
+    }
+    char *path = (char *) calloc(strlen(dir) + 32, sizeof(char));
+    sprintf(path, "%s/keyaudit.XXXXXX", dir);
+    int fd = mkstemp(path);
+    FILE *spill = NULL;
+    if (fd >= 0) {
+        unlink(path);
+        spill = fdopen(fd, "w+");
+    }
+    free(path);
+    return spill;
+}
+
+// This function writes count nodes to the spill file and frees them.
+// This function takes in as parameters FILE *spill, mpz_t *nodes, and size_t count.
+// This function returns false if the nodes could not all be written.
+static bool spill_write(FILE *spill, mpz_t *nodes, size_t count) {
+    bool ok = true;
+    for (size_t i = 0; i < count && ok; i++) {
+        ok = mpz_out_raw(spill, nodes[i]) != 0;
+    }
+    ok = fflush(spill) == 0 && ok;
+    nodes_clear(nodes, count);
+    return ok;
+}
+
+// This function reads count nodes back from the spill file and closes it.
+// This function takes in as parameters FILE *spill and size_t count.
+// This function returns the nodes, or NULL if they could not all be read back.
+static mpz_t *spill_read(FILE *spill, size_t count) {
+    mpz_t *nodes = nodes_init(count);
+    rewind(spill);
+    bool ok = true;
+    for (size_t i = 0; i < count && ok; i++) {
+        ok = mpz_inp_raw(nodes[i], spill) != 0;
+    }
+    fclose(spill);
+    if (!ok) {
+        nodes_clear(nodes, count);
+        return NULL;
+    }
+    return nodes;
+}
+
+// This function closes the spill files that are still open and frees the array holding them.
+// This function takes in as parameters FILE **spills and size_t count.
+static void spills_close(FILE **spills, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (spills[i] != NULL) {
+            fclose(spills[i]);
+        }
+    }
+    free(spills);
+}
+
+// This function finds the factor every modulus shares with the rest with Bernstein's batch GCD. A product tree
+// is built up from the moduli to their product P, and a remainder tree brings P back down modulo the square of
+// every node, so that P mod n^2 divided by n has every prime of n that is also in another modulus. Only the
+// level being computed and the one it is computed from are kept in memory; the rest are spilled to disk.
+// This function takes in as parameters mpz_t *moduli which are replaced by the shared factors, size_t count,
+// char *dir which is where to spill levels to, and bool verbose.
+// This function returns false if a level could not be spilled or read back, after printing an error.
+static bool batch_gcd(mpz_t *moduli, size_t count, char *dir, bool verbose) {
+    size_t depth = 0;
+    for (size_t width = count; width > 1; width = (width + 1) / 2) {
+        depth++;
+    }
+    FILE **spills = (FILE **) calloc(depth, sizeof(FILE *));
+    size_t *widths = (size_t *) calloc(depth + 1, sizeof(size_t));
+
+    // Building the product tree one level at a time, spilling each finished level.
+    mpz_t *below = nodes_init(count);
+    for (size_t i = 0; i < count; i++) {
+        mpz_set(below[i], moduli[i]);
+    }
+    widths[0] = count;
+    for (size_t l = 0; l < depth; l++) {
+        widths[l + 1] = (widths[l] + 1) / 2;
+        tree_level level = { below, widths[l], nodes_init(widths[l + 1]) };
+        parallel_for(product_step, &level, widths[l + 1]);
+        spills[l] = spill_open(dir);
+        if (spills[l] == NULL || spill_write(spills[l], below, widths[l]) == false) {
+            fprintf(stderr, "Error: failed to spill product level %zu.\n", l);
+            if (spills[l] == NULL) {
+                nodes_clear(below, widths[l]);
+            }
+            nodes_clear(level.above, widths[l + 1]);
+            spills_close(spills, depth);
+            free(widths);
+            return false;
+        }
+        below = level.above;
+        if (verbose) {
+            fprintf(stderr, "product level %zu: %zu nodes\n", l + 1, widths[l + 1]);
+        }
+    }
+
+    // Walking the remainder tree back down, reading each level back in as it is needed. A node that cannot be
+    // read back would otherwise be zero, which either divides by zero or reports wrong factors.
+    mpz_t *above = below;
+    for (size_t l = depth; l > 0; l--) {
+        tree_level level = { spill_read(spills[l - 1], widths[l - 1]), widths[l - 1], above };
+        spills[l - 1] = NULL;
+        if (level.below == NULL) {
+            fprintf(stderr, "Error: failed to read back product level %zu.\n", l - 1);
+            nodes_clear(above, widths[l]);
+            spills_close(spills, depth);
+            free(widths);
+            return false;
+        }
+        parallel_for(remainder_step, &level, widths[l - 1]);
+        nodes_clear(above, widths[l]);
+        above = level.below;
+        if (verbose) {
+            fprintf(stderr, "remainder level %zu: %zu nodes\n", l - 1, widths[l - 1]);
+        }
+    }
+
+    tree_level level = { moduli, count, above };
+    parallel_for(factor_step, &level, count);
+    for (size_t i = 0; i < count; i++) {
+        mpz_swap(moduli[i], above[i]);
+    }
+    nodes_clear(above, count);
+    spills_close(spills, depth);
+    free(widths);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    int opt = 0;
+    char *listname = NULL;
+    char *dir = NULL;
+    bool verbose = false;
+
+    // Parsing command-line options using getopt() and handling them accordingly.
+    while ((opt = getopt(argc, argv, OPTIONS)) != -1) {
+        switch (opt) {
+        case 'l': listname = optarg; break;
+        case 't':
+            if (atoi(optarg) > 0) {
+                threads = atoi(optarg);
+            }
+            break;
+        case 'd': dir = optarg; break;
+        case 'v': verbose = true; break;
+        case 'h': help_message(); return EXIT_SUCCESS;
+        default: help_message(); return EXIT_FAILURE;
+        }
+    }
+
+    // Collecting the names of the public key files from the command line and the list file.
+    size_t count = 0;
+    size_t capacity = argc;
+    char **pbnames = (char **) calloc(capacity, sizeof(char *));
+    for (int i = optind; i < argc; i++) {
+        pbnames[count++] = strdup(argv[i]);
+    }
+    if (listname != NULL) {
+        FILE *listfile = fopen(listname, "r");
+        if (listfile == NULL) {
+            fprintf(stderr, "%s: No such file or directory\n", listname);
+            return EXIT_FAILURE;
+        }
+        char line[4096];
+        while (fgets(line, sizeof(line), listfile) != NULL) {
+            line[strcspn(line, "\r\n")] = '\0';
+            if (line[0] == '\0') {
+                continue;
+            }
+            if (count == capacity) {
+                capacity *= 2;
+                pbnames = (char **) realloc(pbnames, capacity * sizeof(char *));
+            }
+            pbnames[count++] = strdup(line);
+        }
+        fclose(listfile);
+    }
+
+    // Reading the public modulus of every key using rsa_read_pub().
+    mpz_t *moduli = nodes_init(count);
+    mpz_t e;
+    mpz_init(e);
+    mpz_t s;
+    mpz_init(s);
+    char username[256];
+    for (size_t i = 0; i < count; i++) {
+        FILE *pbfile = fopen(pbnames[i], "r");
+        if (pbfile == NULL) {
+            fprintf(stderr, "%s: No such file or directory\n", pbnames[i]);
+            return EXIT_FAILURE;
+        }
+        rsa_read_pub(moduli[i], e, s, username, pbfile);
+        fclose(pbfile);
+        if (mpz_cmp_ui(moduli[i], 1) <= 0) {
+            fprintf(stderr, "%s: not a public key file\n", pbnames[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (verbose) {
+        fprintf(stderr, "auditing %zu keys with %zu threads\n", count, threads);
+    }
+
+    // Reporting every modulus that shares a factor with another. A shared factor equal to the modulus means
+    // that both of its primes are shared, possibly with different keys.
+    // If the audit failed, nothing is reported, since the factors cannot be trusted.
+    size_t weak = 0;
+    bool audited = count < 2 || batch_gcd(moduli, count, dir, verbose);
+    for (size_t i = 0; i < count && count > 1 && audited; i++) {
+        if (mpz_cmp_ui(moduli[i], 1) != 0) {
+            gmp_printf("%s: shares factor %Zx\n", pbnames[i], moduli[i]);
+            weak++;
+        }
+    }
+    if (verbose && audited) {
+        fprintf(stderr, "%zu of %zu keys share a factor\n", weak, count);
+    }
+
+    // Clearing all the mpz_t variables and names used in the program.
+    nodes_clear(moduli, count);
+    mpz_clear(e);
+    mpz_clear(s);
+    for (size_t i = 0; i < count; i++) {
+        free(pbnames[i]);
+    }
+    free(pbnames);
+
+    return !audited ? EXIT_FAILURE : weak == 0 ? EXIT_SUCCESS : 2;
+}
@@ -16,14 +16,14 @@
 
 #include <gmp.h>
 
-#define OPTIONS "b:i:n:d:s:vh"
+#define OPTIONS "b:i:n:d:p:s:vh"
 
 void help_message(void) {
     fprintf(stderr, "SYNOPSIS\n"
                     "   Generates an RSA public/private key pair.\n"
                     "\n"
                     "USAGE\n"
-                    "   ./keygen [-hv] [-b bits] -n pbfile -d pvfile\n"
+                    "   ./keygen [-hv] [-b bits] [-p pool] -n pbfile -d pvfile\n"
                     "\n"
                     "OPTIONS\n"
                     "   -h              Display program help and usage.\n"
@@ -32,6 +32,7 @@ void help_message(void) {
                     "   -i confidence   Miller-Rabin iterations for testing primes (default: 50).\n"
                     "   -n pbfile       Public key file (default: rsa.pub).\n"
                     "   -d pvfile       Private key file (default: rsa.priv).\n"
+                    "   -p pool         Prime pool filled by primegen to take primes from.\n"
                     "   -s seed         Random seed for testing.\n");
 }
 
@@ -44,6 +45,7 @@ int main(int argc, char **argv) {
     FILE *pbfile;
     char *pvname = "rsa.priv";
     FILE *pvfile;
+    char *poolname = NULL;
     uint64_t seed = time(NULL);
     bool verbose = false;
 
@@ -62,6 +64,7 @@ int main(int argc, char **argv) {
         case 'n': pbname = optarg; break;
 
         case 'd': pvname = optarg; break;
+        case 'p': poolname = optarg; break;
         case 's':
             temp = optarg;
             if (atoi(temp) == 0) {
@@ -76,6 +79,21 @@ int main(int argc, char **argv) {
         }
     }
 
+    // Checking the prime pool if one was given, before the key files are opened so that a bad pool does not
+    // leave them truncated. The pool holds secret primes, so refuse to use it unless it is only accessible by
+    // its owner.
+    if (poolname != NULL) {
+        struct stat pool_stat;
+        if (stat(poolname, &pool_stat) != 0 || access(poolname, R_OK | W_OK) != 0) {
+            fprintf(stderr, "%s: No such file or directory\n", poolname);
+            return EXIT_FAILURE;
+        }
+        if ((pool_stat.st_mode & 0077) != 0) {
+            fprintf(stderr, "Error: prime pool %s must not be accessible by group or others.\n", poolname);
+            return EXIT_FAILURE;
+        }
+    }
+
     // Opening the public key file using fopen(). Printing a helpful error and exiting the program in the event
     // of failure.
     pbfile = fopen(pbname, "w");
@@ -112,8 +130,21 @@ int main(int argc, char **argv) {
     mpz_t d;
     mpz_init(d);
 
-    // Making the public key using rsa_make_pub().
-    rsa_make_pub(p, q, n, e, bits, iters);
+    // Making the public key using rsa_make_pub(), or with rsa_make_pub_pool() when a prime pool was given.
+    // If the primes could not be removed from the pool they may be handed out again, so abort rather than use
+    // them.
+    if (poolname != NULL) {
+        if (!rsa_make_pub_pool(p, q, n, e, bits, iters, poolname)) {
+            fprintf(stderr, "Error: failed to claim primes from prime pool %s.\n", poolname);
+            fclose(pbfile);
+            fclose(pvfile);
+            unlink(pbname);
+            unlink(pvname);
+            return EXIT_FAILURE;
+        }
+    } else {
+        rsa_make_pub(p, q, n, e, bits, iters);
+    }
     // Making the private key using rsa_make_priv().
     rsa_make_priv(d, e, p, q);
 
@@ -0,0 +1,254 @@
+#include "lz.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The compressed stream is a sequence of frames, each holding up to LZ_FRAME_BYTES bytes of input. A frame
+// starts with a header of the input length and the payload length as big endian 32 bit words, where the top
+// bit of the payload length marks a frame stored as is because it did not compress. A compressed payload is a
+// sequence of LZ77 matches in the style of LZ4: a token byte whose high and low nibbles are the number of
+// literals and the match length minus MIN_MATCH, the literals, then a little endian 16 bit offset back to the
+// match. A nibble of 15 continues in extra bytes that are added until one is below 255. The last sequence of
+// a frame only has literals.
+
+#define MIN_MATCH   4
+#define MAX_OFFSET  65535
+#define HASH_BITS   14
+#define STORED_FLAG 0x80000000u
+
+// This function hashes the MIN_MATCH bytes at p into the match finder's table.
+// This function takes in as a parameter const uint8_t *p.
+// This function returns the index into the table.
+static uint32_t hash4(const uint8_t *p) {
+    uint32_t v = (uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+    return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// This function writes a length that did not fit in its nibble as a run of 255s and a final smaller byte.
+// This function takes in as parameters uint8_t *out and size_t len which is the remainder past 15.
+// This function returns the number of bytes written.
+static size_t put_length(uint8_t *out, size_t len) {
+    size_t n = 0;
+    while (len >= 255) {
+        out[n++] = 255;
+        len -= 255;
+    }
+    out[n++] = (uint8_t) len;
+    return n;
+}
+
+// This function writes one sequence of literals followed by a match, or only literals if match_len is 0.
+// This function takes in as parameters uint8_t *out, const uint8_t *literals, size_t lit_len, size_t offset,
+// and size_t match_len.
+// This function returns the number of bytes written.
+static size_t put_sequence(uint8_t *out, const uint8_t *literals, size_t lit_len, size_t offset, size_t match_len) {
+    size_t n = 1;
+    size_t extra = match_len == 0 ? 0 : match_len - MIN_MATCH;
+    out[0] = (uint8_t) ((lit_len < 15 ? lit_len : 15) << 4 | (extra < 15 ? extra : 15));
+    if (lit_len >= 15) {
+        n += put_length(out + n, lit_len - 15);
+    }
+    memcpy(out + n, literals, lit_len);
+    n += lit_len;
+    if (match_len != 0) {
+        out[n++] = (uint8_t) offset;
+        out[n++] = (uint8_t) (offset >> 8);
+        if (extra >= 15) {
+            n += put_length(out + n, extra - 15);
+        }
+    }
+    return n;
+}
+
+// This function reads a length that continues past its nibble.
+// This function takes in as parameters const uint8_t *in, size_t len, size_t *pos which is advanced past the
+// length, and size_t *value which the extra bytes are added to.
+// This function returns false if the input ends in the middle of the length.
+static bool get_length(const uint8_t *in, size_t len, size_t *pos, size_t *value) {
+    uint8_t byte;
+    do {
+        if (*pos >= len) {
+            return false;
+        }
+        byte = in[(*pos)++];
+        *value += byte;
+    } while (byte == 255);
+    return true;
+}
+
+// This function decompresses a frame's payload.
+// This function takes in as parameters uint8_t *out, size_t out_len which is the expected input length of the
+// frame, const uint8_t *in, and size_t len.
+// This function returns true if the payload decompressed to exactly out_len bytes.
+static bool decompress(uint8_t *out, size_t out_len, const uint8_t *in, size_t len) {
+    size_t ip = 0;
+    size_t op = 0;
+    while (ip < len) {
+        uint8_t token = in[ip++];
+        size_t lit_len = token >> 4;
+        if (lit_len == 15 && !get_length(in, len, &ip, &lit_len)) {
+            return false;
+        }
+        if (lit_len > len - ip || lit_len > out_len - op) {
+            return false;
+        }
+        memcpy(out + op, in + ip, lit_len);
+        ip += lit_len;
+        op += lit_len;
+        if (ip == len) {
+            break;
+        }
+
+        if (len - ip < 2) {
+            return false;
+        }
+        size_t offset = (size_t) in[ip] | (size_t) in[ip + 1] << 8;
+        ip += 2;
+        size_t match_len = token & 15;
+        if (match_len == 15 && !get_length(in, len, &ip, &match_len)) {
+            return false;
+        }
+        match_len += MIN_MATCH;
+        if (offset == 0 || offset > op || match_len > out_len - op) {
+            return false;
+        }
+        for (size_t i = 0; i < match_len; i++, op++) {
+            out[op] = out[op - offset];
+        }
+    }
+    return op == out_len;
+}
+
+// This function computes the largest a frame for len bytes of input can be.
+// This function takes in as a parameter size_t len.
+// This function returns the size of the buffer that lz_compress_frame() needs.
+size_t lz_frame_bound(size_t len) {
+    return LZ_HEADER_BYTES + len + len / 255 + 16;
+}
+
+// This function compresses up to LZ_FRAME_BYTES bytes of input into a frame, storing the input as is if it
+// does not compress.
+// This function takes in as parameters uint8_t *out which must hold lz_frame_bound(len) bytes,
+// const uint8_t *in, and size_t len.
+// This function returns the number of bytes written to out.
+size_t lz_compress_frame(uint8_t *out, const uint8_t *in, size_t len) {
+    uint32_t table[1 << HASH_BITS];
+    memset(table, 0, sizeof(table));
+
+    uint8_t *payload = out + LZ_HEADER_BYTES;
+    size_t n = 0;
+    size_t anchor = 0;
+    size_t ip = 0;
+    while (ip + MIN_MATCH <= len) {
+        uint32_t h = hash4(in + ip);
+        size_t ref = table[h];
+        table[h] = (uint32_t) ip + 1;
+        if (ref == 0 || ip + 1 - ref > MAX_OFFSET || memcmp(in + ref - 1, in + ip, MIN_MATCH) != 0) {
+            ip++;
+            continue;
+        }
+        ref--;
+        size_t match_len = MIN_MATCH;
+        while (ip + match_len < len && in[ref + match_len] == in[ip + match_len]) {
+            match_len++;
+        }
+        n += put_sequence(payload + n, in + anchor, ip - anchor, ip - ref, match_len);
+        ip += match_len;
+        anchor = ip;
+    }
+    n += put_sequence(payload + n, in + anchor, len - anchor, 0, 0);
+
+    uint32_t payload_len = (uint32_t) n;
+    if (n >= len) {
+        memcpy(payload, in, len);
+        payload_len = (uint32_t) len | STORED_FLAG;
+        n = len;
+    }
+    for (int i = 0; i < 4; i++) {
+        out[i] = (uint8_t) (len >> (24 - 8 * i));
+        out[4 + i] = (uint8_t) (payload_len >> (24 - 8 * i));
+    }
+    return LZ_HEADER_BYTES + n;
+}
+
+// This function sets up a decoder for a compressed stream that arrives in pieces.
+// This function takes in as a parameter lz_decoder *dec.
+void lz_decoder_init(lz_decoder *dec) {
+    dec->payload = (uint8_t *) calloc(lz_frame_bound(LZ_FRAME_BYTES), sizeof(uint8_t));
+    dec->raw = (uint8_t *) calloc(LZ_FRAME_BYTES, sizeof(uint8_t));
+    dec->have = 0;
+    dec->need = LZ_HEADER_BYTES;
+    dec->raw_len = 0;
+    dec->stored = false;
+    dec->corrupt = false;
+}
+
+// This function feeds the next piece of a compressed stream to a decoder, writing the input of every frame
+// that it completes to outfile.
+// This function takes in as parameters lz_decoder *dec, const uint8_t *in, size_t len, and FILE *outfile.
+// This function returns false if the stream is corrupt, after which the rest of it is ignored.
+bool lz_decoder_feed(lz_decoder *dec, const uint8_t *in, size_t len, FILE *outfile) {
+    while (len > 0 && !dec->corrupt) {
+        bool in_header = dec->raw_len == 0;
+        uint8_t *dest = in_header ? dec->header : dec->payload;
+        size_t take = dec->need - dec->have < len ? dec->need - dec->have : len;
+        memcpy(dest + dec->have, in, take);
+        dec->have += take;
+        in += take;
+        len -= take;
+        if (dec->have < dec->need) {
+            break;
+        }
+
+        if (in_header) {
+            uint32_t raw_len = 0;
+            uint32_t payload_len = 0;
+            for (int i = 0; i < 4; i++) {
+                raw_len = raw_len << 8 | dec->header[i];
+                payload_len = payload_len << 8 | dec->header[4 + i];
+            }
+            dec->stored = (payload_len & STORED_FLAG) != 0;
+            payload_len &= ~STORED_FLAG;
+            if (raw_len == 0 || raw_len > LZ_FRAME_BYTES || payload_len > lz_frame_bound(LZ_FRAME_BYTES)
+                || (dec->stored && payload_len != raw_len)) {
+                dec->corrupt = true;
+                break;
+            }
+            dec->raw_len = raw_len;
+            dec->need = payload_len;
+            dec->have = 0;
+            continue;
+        }
+
+        if (dec->stored) {
+            fwrite(dec->payload, sizeof(uint8_t), dec->raw_len, outfile);
+        } else if (decompress(dec->raw, dec->raw_len, dec->payload, dec->need)) {
+            fwrite(dec->raw, sizeof(uint8_t), dec->raw_len, outfile);
+        } else {
+            dec->corrupt = true;
+            break;
+        }
+        dec->raw_len = 0;
+        dec->stored = false;
+        dec->need = LZ_HEADER_BYTES;
+        dec->have = 0;
+    }
+    return !dec->corrupt;
+}
+
+// This function checks that a compressed stream did not end in the middle of a frame.
+// This function takes in as a parameter lz_decoder *dec.
+// This function returns true if every frame fed to the decoder was complete and intact.
+bool lz_decoder_finish(lz_decoder *dec) {
+    return !dec->corrupt && dec->have == 0 && dec->raw_len == 0;
+}
+
+// This function frees the memory used by a decoder.
+// This function takes in as a parameter lz_decoder *dec.
+void lz_decoder_clear(lz_decoder *dec) {
+    free(dec->payload);
+    free(dec->raw);
+}
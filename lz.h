@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define LZ_FRAME_BYTES  (1 << 16)
+#define LZ_HEADER_BYTES 8
+
+typedef struct {
+    uint8_t header[LZ_HEADER_BYTES];
+    uint8_t *payload;
+    uint8_t *raw;
+    size_t have;
+    size_t need;
+    size_t raw_len;
+    bool stored;
+    bool corrupt;
+} lz_decoder;
+
+size_t lz_frame_bound(size_t len);
+
+size_t lz_compress_frame(uint8_t *out, const uint8_t *in, size_t len);
+
+void lz_decoder_init(lz_decoder *dec);
+
+bool lz_decoder_feed(lz_decoder *dec, const uint8_t *in, size_t len, FILE *outfile);
+
+bool lz_decoder_finish(lz_decoder *dec);
+
+void lz_decoder_clear(lz_decoder *dec);
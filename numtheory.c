@@ -178,28 +178,132 @@ void make_prime(mpz_t p, uint64_t bits, uint64_t iters) {
     } while (is_prime(p, iters) == false || mpz_sizeinbase(p, 2) < bits + 1);
 }
 
+// Bits of the leading digits that Lehmer's algorithm runs its single precision Euclid steps on. It is kept a few
+// bits short of 63 so that the digits plus their cofactors never overflow an int64_t.
+#define LEHMER_BITS 60
+
+// This function computes the greatest common divisor of two words with the binary GCD algorithm, which only
+// needs shifts and subtractions.
+// This function takes in as parameters uint64_t a and uint64_t b.
+// This function returns the greatest common divisor of a and b.
+static uint64_t gcd_word(uint64_t a, uint64_t b) {
+    if (a == 0 || b == 0) {
+        return a | b;
+    }
+    int shift = __builtin_ctzll(a | b);
+    a >>= __builtin_ctzll(a);
+    while (b != 0) {
+        b >>= __builtin_ctzll(b);
+        if (a > b) {
+            uint64_t temp = a;
+            a = b;
+            b = temp;
+        }
+        b -= a;
+    }
+    return a << shift;
+}
+
+// This function runs Lehmer's single precision Euclid steps on the leading LEHMER_BITS bits of a and b, where
+// a >= b, collecting the steps in the cofactor matrix cof so that (A * a + B * b, C * a + D * b) are the
+// remainders the full precision steps would have reached. The steps stop as soon as the leading bits can no
+// longer guarantee the quotient of the full values.
+// This function takes in as parameters int64_t cof[4] which holds A, B, C, and D, mpz_t a, mpz_t b, and
+// mpz_t temp which is scratch space.
+// This function returns true if at least one quotient was predicted, and false if a full precision division
+// step is needed instead.
+static bool lehmer_cofactors(int64_t cof[4], mpz_t a, mpz_t b, mpz_t temp) {
+    size_t size = mpz_sizeinbase(a, 2);
+    size_t shift = size > LEHMER_BITS ? size - LEHMER_BITS : 0;
+    mpz_tdiv_q_2exp(temp, a, shift);
+    int64_t x = (int64_t) mpz_get_ui(temp);
+    mpz_tdiv_q_2exp(temp, b, shift);
+    int64_t y = (int64_t) mpz_get_ui(temp);
+
+    int64_t A = 1;
+    int64_t B = 0;
+    int64_t C = 0;
+    int64_t D = 1;
+    while (y + C != 0 && y + D != 0) {
+        int64_t q = (x + A) / (y + C);
+        if (q != (x + B) / (y + D)) {
+            break;
+        }
+        int64_t t = A - q * C;
+        A = C;
+        C = t;
+        t = B - q * D;
+        B = D;
+        D = t;
+        t = x - q * y;
+        x = y;
+        y = t;
+    }
+    cof[0] = A;
+    cof[1] = B;
+    cof[2] = C;
+    cof[3] = D;
+    return B != 0;
+}
+
+// This function replaces (u, v) with (A * u + B * v, C * u + D * v) for the cofactor matrix cof.
+// This function takes in as parameters int64_t cof[4], mpz_t u, mpz_t v, and mpz_t temp and mpz_t temp2 which
+// are scratch space.
+static void lehmer_apply(int64_t cof[4], mpz_t u, mpz_t v, mpz_t temp, mpz_t temp2) {
+    mpz_mul_si(temp, u, cof[0]);
+    mpz_mul_si(temp2, v, cof[1]);
+    mpz_add(temp, temp, temp2);
+    mpz_mul_si(u, u, cof[2]);
+    mpz_mul_si(temp2, v, cof[3]);
+    mpz_add(v, u, temp2);
+    mpz_swap(u, temp);
+}
+
 // This function computes the greatest common divisor of a and b, storing the value of the computed
-// divisor in d.
+// divisor in d. Lehmer's algorithm shrinks the operands until the smaller one fits in a word, and the binary
+// GCD algorithm finishes the rest.
 // This function takes in as parameters mpz_t d which is where the gcd of a and b is going to be stored,
 // mpz_t a, and mpz_t b.
 void gcd(mpz_t d, mpz_t a, mpz_t b) {
     mpz_t a_temp;
     mpz_init(a_temp);
-    mpz_set(a_temp, a);
+    mpz_abs(a_temp, a);
     mpz_t b_temp;
     mpz_init(b_temp);
-    mpz_set(b_temp, b);
-    while (mpz_cmp_ui(b_temp, 0) != 0) {
-        mpz_set(d, b_temp);
-        mpz_mmod(b_temp, a_temp, b_temp);
-        mpz_set(a_temp, d);
+    mpz_abs(b_temp, b);
+    mpz_t temp;
+    mpz_init(temp);
+    mpz_t temp2;
+    mpz_init(temp2);
+    int64_t cof[4];
+
+    if (mpz_cmp(a_temp, b_temp) < 0) {
+        mpz_swap(a_temp, b_temp);
+    }
+    while (mpz_size(b_temp) > 1) {
+        if (lehmer_cofactors(cof, a_temp, b_temp, temp)) {
+            lehmer_apply(cof, a_temp, b_temp, temp, temp2);
+        } else {
+            mpz_tdiv_r(a_temp, a_temp, b_temp);
+            mpz_swap(a_temp, b_temp);
+        }
+    }
+
+    if (mpz_cmp_ui(b_temp, 0) == 0) {
+        mpz_set(d, a_temp);
+    } else {
+        uint64_t b_word = mpz_get_ui(b_temp);
+        mpz_set_ui(d, gcd_word(b_word, mpz_fdiv_ui(a_temp, b_word)));
     }
-    mpz_set(d, a_temp);
     mpz_clear(a_temp);
     mpz_clear(b_temp);
+    mpz_clear(temp);
+    mpz_clear(temp2);
 }
 
-// This function computes the inverse i of a modulo n.
+// This function computes the inverse i of a modulo n with Lehmer's extended Euclidean algorithm, which batches
+// the Euclid steps it can predict from the leading bits of the remainders into one update of the remainders
+// and the cofactors.
 // This function takes in as parameters mpz_t i which is where the modulo inverse will be stored, mpz_t a, and mpz_t n.
 void mod_inverse(mpz_t i, mpz_t a, mpz_t n) {
     mpz_t r;
@@ -214,6 +318,9 @@ void mod_inverse(mpz_t i, mpz_t a, mpz_t n) {
     mpz_init(q);
     mpz_t temp;
     mpz_init(temp);
+    mpz_t temp2;
+    mpz_init(temp2);
+    int64_t cof[4];
 
     mpz_set(r, n);
     mpz_set(r_prime, a);
@@ -221,17 +328,15 @@ void mod_inverse(mpz_t i, mpz_t a, mpz_t n) {
     mpz_set_ui(t_prime, 1);
 
     while (mpz_cmp_ui(r_prime, 0) != 0) {
-        mpz_div(q, r, r_prime);
-
-        mpz_set(temp, r);
-        mpz_set(r, r_prime);
-        mpz_mul(r_prime, q, r_prime);
-        mpz_sub(r_prime, temp, r_prime);
-
-        mpz_set(temp, t);
-        mpz_set(t, t_prime);
-        mpz_mul(t_prime, q, t_prime);
-        mpz_sub(t_prime, temp, t_prime);
+        if (mpz_cmp(r, r_prime) >= 0 && lehmer_cofactors(cof, r, r_prime, temp)) {
+            lehmer_apply(cof, r, r_prime, temp, temp2);
+            lehmer_apply(cof, t, t_prime, temp, temp2);
+        } else {
+            mpz_tdiv_qr(q, r, r, r_prime);
+            mpz_swap(r, r_prime);
+            mpz_submul(t, q, t_prime);
+            mpz_swap(t, t_prime);
+        }
     }
 
     if (mpz_cmp_ui(r, 1) > 0) {
@@ -248,4 +353,5 @@ void mod_inverse(mpz_t i, mpz_t a, mpz_t n) {
     mpz_clear(t_prime);
     mpz_clear(q);
     mpz_clear(temp);
+    mpz_clear(temp2);
 }
@@ -0,0 +1,138 @@
+#include "numtheory.h"
+#include "primepool.h"
+#include "randstate.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <gmp.h>
+
+#define OPTIONS "b:c:i:n:s:w:vh"
+
+void help_message(void) {
+    fprintf(stderr, "SYNOPSIS\n"
+                    "   Fills a prime pool that keygen takes RSA primes from.\n"
+                    "\n"
+                    "USAGE\n"
+                    "   ./primegen [-hv] [-b bits] [-c count] [-w seconds] -n pool\n"
+                    "\n"
+                    "OPTIONS\n"
+                    "   -h              Display program help and usage.\n"
+                    "   -v              Display verbose program output.\n"
+                    "   -b bits         Minimum bits of the public keys the primes are for (default: 256).\n"
+                    "   -c count        Number of key pairs' worth of primes to keep (default: 16).\n"
+                    "   -i confidence   Miller-Rabin iterations for testing primes (default: 50).\n"
+                    "   -n pool         Prime pool file (default: rsa.pool).\n"
+                    "   -s seed         Random seed for testing (default: read from /dev/urandom).\n"
+                    "   -w seconds      Keep running, topping the pool up every given seconds.\n");
+}
+
+// This function tops up the bucket for bits in pool to count primes, generating each missing prime with
+// make_prime() before taking the pool lock so that claimers are never blocked by the prime search.
+// This function takes in as parameters const char *poolname, uint64_t bits, uint64_t count, uint64_t iters, and
+// bool verbose.
+// This function returns false if the pool could not be written.
+bool fill_bucket(const char *poolname, uint64_t bits, uint64_t count, uint64_t iters, bool verbose) {
+    mpz_t p;
+    mpz_init(p);
+    bool ok = true;
+    uint64_t have = pool_count(poolname, bits);
+    for (uint64_t i = have; i < count && ok; i++) {
+        make_prime(p, bits, iters);
+        ok = pool_add(poolname, p, bits);
+        if (verbose && ok) {
+            gmp_printf("p (%d bits) = %Zd\n", mpz_sizeinbase(p, 2), p);
+        }
+    }
+    mpz_clear(p);
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    int opt = 0;
+    char *temp;
+    uint64_t bits = 256;
+    uint64_t count = 16;
+    uint64_t iters = 50;
+    char *poolname = "rsa.pool";
+    int poolfd;
+    uint64_t seed = 0;
+    uint64_t wait = 0;
+    bool verbose = false;
+
+    // Parsing command-line options using getopt() and handling them accordingly.
+    while ((opt = getopt(argc, argv, OPTIONS)) != -1) {
+        switch (opt) {
+        case 'b': bits = atoi(optarg); break;
+        case 'c': count = atoi(optarg); break;
+        case 'i':
+            temp = optarg;
+            if (atoi(temp) == 0) {
+                break;
+            } else {
+                iters = atoi(temp);
+                break;
+            }
+        case 'n': poolname = optarg; break;
+        case 's':
+            temp = optarg;
+            if (atoi(temp) == 0) {
+                break;
+            } else {
+                seed = atoi(temp);
+                break;
+            }
+        case 'w': wait = atoi(optarg); break;
+        case 'v': verbose = true; break;
+        case 'h': help_message(); return EXIT_SUCCESS;
+        default: help_message(); return EXIT_FAILURE;
+        }
+    }
+
+    // Creating the prime pool with permissions 0600 if it does not exist yet so that only the user can read the
+    // primes in it. Printing a helpful error and exiting the program in the event of failure.
+    poolfd = open(poolname, O_RDWR | O_CREAT, 0600);
+    if (poolfd < 0) {
+        fprintf(stderr, "Error: failed to open file.\n");
+        return EXIT_FAILURE;
+    }
+    fchmod(poolfd, 0600);
+    close(poolfd);
+
+    // Initializing the random state. The primes are secret, so they are seeded from /dev/urandom unless a seed
+    // was given with -s for testing.
+    if (seed != 0) {
+        randstate_init(seed);
+    } else if (!randstate_init_urandom()) {
+        fprintf(stderr, "Error: failed to read /dev/urandom.\n");
+        return EXIT_FAILURE;
+    }
+
+    // keygen splits the bits of n evenly between p and q when taking primes from a pool, so fill both of the
+    // buckets it will ask for. If -w was given, keep topping the pool up as keygen drains it.
+    bool ok = true;
+    do {
+        ok = fill_bucket(poolname, bits / 2, bits % 2 == 0 ? 2 * count : count, iters, verbose);
+        if (ok && bits % 2 != 0) {
+            ok = fill_bucket(poolname, bits - bits / 2, count, iters, verbose);
+        }
+        if (ok && wait > 0) {
+            sleep(wait);
+        }
+    } while (ok && wait > 0);
+    if (!ok) {
+        fprintf(stderr, "Error: failed to write prime pool %s.\n", poolname);
+    }
+
+    // Clearing the random state with randstate_clear().
+    randstate_clear();
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
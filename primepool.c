@@ -0,0 +1,245 @@
+#include "primepool.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <gmp.h>
+
+// This function takes the exclusive or shared lock on a pool. The lock is held on a separate file named after
+// the pool with .lock appended, because pool_claim() replaces the pool file itself.
+// This function takes in as parameters const char *poolname and int operation which is LOCK_EX or LOCK_SH.
+// This function returns the descriptor holding the lock, to be passed to pool_unlock(), or -1 on failure.
+static int pool_lock(const char *poolname, int operation) {
+    size_t len = strlen(poolname);
+    char *lockname = (char *) calloc(len + sizeof(".lock"), sizeof(char));
+    memcpy(lockname, poolname, len);
+    memcpy(lockname + len, ".lock", sizeof(".lock"));
+    int fd = open(lockname, O_RDWR | O_CREAT, 0600);
+    free(lockname);
+    if (fd >= 0 && flock(fd, operation) != 0) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+// This function releases a lock taken with pool_lock().
+// This function takes in as a parameter int fd.
+static void pool_unlock(int fd) {
+    flock(fd, LOCK_UN);
+    close(fd);
+}
+
+// This function reads the whole pool file into a newly allocated, NUL terminated buffer. The caller must hold
+// the lock on the pool and free the returned buffer. A pool that does not exist yet reads as empty.
+// This function takes in as parameters const char *poolname and a size_t *len where the length of the contents
+// is stored.
+// This function returns the buffer, or NULL if the pool could not be read.
+static char *pool_slurp(const char *poolname, size_t *len) {
+    FILE *pool = fopen(poolname, "r");
+    *len = 0;
+    if (pool == NULL) {
+        return (char *) calloc(1, sizeof(char));
+    }
+    fseek(pool, 0, SEEK_END);
+    long size = ftell(pool);
+    rewind(pool);
+    if (size < 0) {
+        fclose(pool);
+        return NULL;
+    }
+    char *buffer = (char *) calloc(size + 1, sizeof(char));
+    *len = fread(buffer, sizeof(char), size, pool);
+    buffer[*len] = '\0';
+    bool failed = ferror(pool) != 0;
+    fclose(pool);
+    if (failed) {
+        free(buffer);
+        return NULL;
+    }
+    return buffer;
+}
+
+// This function finds the end of the entry starting at line. Only entries ending in a newline are complete;
+// anything after the last newline was cut off while being appended and is never handed out.
+// This function takes in as parameters char *line and size_t left which is the number of bytes after line.
+// This function returns the length of the entry including its newline, and sets *complete accordingly.
+static size_t pool_entry(char *line, size_t left, bool *complete) {
+    char *next = memchr(line, '\n', left);
+    *complete = next != NULL;
+    return next == NULL ? left : (size_t) (next - line) + 1;
+}
+
+// This function replaces the pool with the given contents. They are written to a temporary file in the same
+// directory which is synced and then renamed over the pool, so the pool always holds either the old or the new
+// contents, even if the program dies partway through. The caller must hold the lock on the pool.
+// This function takes in as parameters const char *poolname, char *contents, and size_t len.
+// This function returns false if the pool could not be replaced, in which case it is left as it was.
+static bool pool_replace(const char *poolname, char *contents, size_t len) {
+    size_t name_len = strlen(poolname);
+    char *tempname = (char *) calloc(name_len + sizeof(".XXXXXX"), sizeof(char));
+    memcpy(tempname, poolname, name_len);
+    memcpy(tempname + name_len, ".XXXXXX", sizeof(".XXXXXX"));
+
+    int fd = mkstemp(tempname);
+    FILE *temp = fd < 0 ? NULL : fdopen(fd, "w");
+    bool ok = temp != NULL;
+    if (ok) {
+        ok = fwrite(contents, sizeof(char), len, temp) == len && fflush(temp) == 0 && fsync(fd) == 0;
+        ok = fclose(temp) == 0 && ok;
+    } else if (fd >= 0) {
+        close(fd);
+    }
+    if (ok) {
+        ok = rename(tempname, poolname) == 0;
+    }
+    if (!ok && fd >= 0) {
+        unlink(tempname);
+    }
+    free(tempname);
+    return ok;
+}
+
+// This function appends the prime p to the bucket for bits in pool unless the pool already holds it. Each entry
+// is a line holding the bucket size in decimal followed by the prime in hexadecimal.
+// This function takes in as parameters const char *poolname, mpz_t p, and uint64_t bits which is the size that
+// was passed to make_prime() when p was generated.
+// This function returns false if the pool could not be read or written.
+bool pool_add(const char *poolname, mpz_t p, uint64_t bits) {
+    int lock = pool_lock(poolname, LOCK_EX);
+    if (lock < 0) {
+        return false;
+    }
+    size_t len;
+    char *buffer = pool_slurp(poolname, &len);
+    char *entry = NULL;
+    gmp_asprintf(&entry, "%" PRIu64 " %Zx\n", bits, p);
+    bool ok = buffer != NULL;
+
+    // Refusing to add a prime twice, since two keys sharing a prime can both be factored.
+    bool duplicate = false;
+    bool complete = true;
+    size_t entry_len = strlen(entry);
+    size_t offset = 0;
+    size_t line_len = 0;
+    while (ok && offset < len && !duplicate) {
+        line_len = pool_entry(buffer + offset, len - offset, &complete);
+        duplicate = complete && line_len == entry_len && memcmp(buffer + offset, entry, entry_len) == 0;
+        offset += line_len;
+    }
+
+    // Dropping an entry that was cut off by an earlier crash, since appending to it would merge the two.
+    if (ok && !duplicate && !complete) {
+        ok = pool_replace(poolname, buffer, len - line_len);
+    }
+    if (ok && !duplicate) {
+        FILE *pool = fopen(poolname, "a");
+        ok = pool != NULL;
+        if (ok) {
+            ok = fwrite(entry, sizeof(char), entry_len, pool) == entry_len && fflush(pool) == 0
+                 && fsync(fileno(pool)) == 0;
+            ok = fclose(pool) == 0 && ok;
+        }
+    }
+    pool_unlock(lock);
+    free(entry);
+    free(buffer);
+    return ok;
+}
+
+// This function counts the primes waiting in the bucket for bits in pool.
+// This function takes in as parameters const char *poolname and uint64_t bits.
+// This function returns the number of primes in the bucket.
+uint64_t pool_count(const char *poolname, uint64_t bits) {
+    int lock = pool_lock(poolname, LOCK_SH);
+    if (lock < 0) {
+        return 0;
+    }
+    size_t len;
+    char *buffer = pool_slurp(poolname, &len);
+    pool_unlock(lock);
+    if (buffer == NULL) {
+        return 0;
+    }
+
+    uint64_t count = 0;
+    size_t offset = 0;
+    while (offset < len) {
+        bool complete;
+        char *line = buffer + offset;
+        offset += pool_entry(line, len - offset, &complete);
+        if (complete && strtoull(line, NULL, 10) == bits) {
+            count++;
+        }
+    }
+    free(buffer);
+    return count;
+}
+
+// This function claims a prime from the bucket for pbits into p and a prime from the bucket for qbits into q,
+// removing them from pool. Both primes are taken while holding a single exclusive lock, so concurrent
+// claimers never receive the same prime.
+// This function takes in as parameters const char *poolname, mpz_t p, uint64_t pbits, bool *got_p which is set
+// to whether p was claimed, mpz_t q, uint64_t qbits, and bool *got_q which is set to whether q was claimed.
+// This function returns false if the pool could not be read or the claimed primes could not be removed from
+// it, in which case neither prime may be used.
+bool pool_claim(const char *poolname, mpz_t p, uint64_t pbits, bool *got_p, mpz_t q, uint64_t qbits, bool *got_q) {
+    *got_p = false;
+    *got_q = false;
+    int lock = pool_lock(poolname, LOCK_EX);
+    if (lock < 0) {
+        return false;
+    }
+    size_t len;
+    char *buffer = pool_slurp(poolname, &len);
+    if (buffer == NULL) {
+        pool_unlock(lock);
+        return false;
+    }
+
+    size_t kept = 0;
+    size_t offset = 0;
+    while (offset < len) {
+        bool complete;
+        char *line = buffer + offset;
+        size_t line_len = pool_entry(line, len - offset, &complete);
+        offset += line_len;
+        if (!complete) {
+            continue;
+        }
+
+        char *hex;
+        uint64_t bits = strtoull(line, &hex, 10);
+        bool *got = NULL;
+        if (hex != line && !*got_p && bits == pbits) {
+            got = got_p;
+        } else if (hex != line && !*got_q && bits == qbits) {
+            got = got_q;
+        }
+        if (got != NULL) {
+            line[line_len - 1] = '\0';
+            *got = mpz_set_str(got == got_p ? p : q, hex + 1, 16) == 0;
+            line[line_len - 1] = '\n';
+            if (*got) {
+                continue;
+            }
+        }
+        memmove(buffer + kept, line, line_len);
+        kept += line_len;
+    }
+
+    bool ok = kept == len || pool_replace(poolname, buffer, kept);
+    if (!ok) {
+        *got_p = false;
+        *got_q = false;
+    }
+    pool_unlock(lock);
+    free(buffer);
+    return ok;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <gmp.h>
+
+bool pool_add(const char *poolname, mpz_t p, uint64_t bits);
+
+uint64_t pool_count(const char *poolname, uint64_t bits);
+
+bool pool_claim(const char *poolname, mpz_t p, uint64_t pbits, bool *got_p, mpz_t q, uint64_t qbits, bool *got_q);
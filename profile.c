@@ -0,0 +1,213 @@
+#include "profile.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+// Each power of two range of block latencies is split into this many linear sub-buckets, which bounds the
+// error of a reported percentile to 1 / SUB_BUCKETS of its value.
+#define SUB_BUCKETS     8
+#define SUB_BUCKET_BITS 3
+#define BUCKETS         (64 * SUB_BUCKETS)
+
+static const char *phase_names[PROFILE_PHASES] = { "input", "convert", "exponentiate", "output" };
+
+static bool enabled = false;
+static _Atomic uint64_t phase_ns[PROFILE_PHASES];
+static _Atomic uint64_t histogram[BUCKETS];
+static _Atomic uint64_t blocks;
+static _Atomic uint64_t max_ns;
+static uint64_t started;
+static int cycles_fd = -1;
+static int instructions_fd = -1;
+
+#ifdef __linux__
+// This function opens a user space hardware counter for this process and the threads it creates later.
+// This function takes in as a parameter uint64_t config which is the PERF_COUNT_HW_* event to count.
+// This function returns the counter's file descriptor, or -1 if the kernel does not allow it.
+static int counter_open(uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.inherit = 1;
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+// This function reads the value of the hardware counter opened as fd.
+// This function takes in as a parameter int fd.
+// This function returns the counted events, or 0 if the counter is not open.
+static uint64_t counter_read(int fd) {
+    uint64_t value = 0;
+    if (fd < 0 || read(fd, &value, sizeof(value)) != sizeof(value)) {
+        return 0;
+    }
+    return value;
+}
+
+// This function maps a block latency to its histogram bucket. Latencies below SUB_BUCKETS nanoseconds get a
+// bucket each, and every power of two range above that is split into SUB_BUCKETS buckets.
+// This function takes in as a parameter uint64_t ns.
+// This function returns the index of the bucket.
+static size_t bucket_of(uint64_t ns) {
+    if (ns < SUB_BUCKETS) {
+        return ns;
+    }
+    int msb = 63 - __builtin_clzll(ns);
+    return (size_t) (msb - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + ((ns >> (msb - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+}
+
+// This function maps a histogram bucket back to the largest latency it holds.
+// This function takes in as a parameter size_t bucket.
+// This function returns the upper bound of the bucket in nanoseconds.
+static uint64_t bucket_limit(size_t bucket) {
+    if (bucket < SUB_BUCKETS) {
+        return bucket;
+    }
+    int msb = (int) (bucket / SUB_BUCKETS) + SUB_BUCKET_BITS - 1;
+    uint64_t low = (uint64_t) (SUB_BUCKETS + bucket % SUB_BUCKETS) << (msb - SUB_BUCKET_BITS);
+    return low + (1ULL << (msb - SUB_BUCKET_BITS)) - 1;
+}
+
+// This function finds the latency below which the given share of the recorded blocks fall.
+// This function takes in as a parameter double share which is between 0 and 1.
+// This function returns the percentile in nanoseconds, never more than the largest recorded latency.
+static uint64_t percentile(double share) {
+    uint64_t total = atomic_load(&blocks);
+    uint64_t rank = (uint64_t) (share * total + 0.5);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; i++) {
+        seen += atomic_load(&histogram[i]);
+        if (seen >= rank && seen > 0) {
+            uint64_t limit = bucket_limit(i);
+            return limit < atomic_load(&max_ns) ? limit : atomic_load(&max_ns);
+        }
+    }
+    return atomic_load(&max_ns);
+}
+
+// This function turns profiling on. Until it is called, every other profile function does nothing, so the
+// programs can call them unconditionally.
+// This function takes in as a parameter bool counters which is whether to also count CPU cycles and
+// instructions, which is only supported on Linux.
+void profile_init(bool counters) {
+    enabled = true;
+#ifdef __linux__
+    if (counters) {
+        cycles_fd = counter_open(PERF_COUNT_HW_CPU_CYCLES);
+        instructions_fd = counter_open(PERF_COUNT_HW_INSTRUCTIONS);
+    }
+#else
+    (void) counters;
+#endif
+    started = profile_now();
+}
+
+// This function reads the monotonic clock.
+// This function returns the current time in nanoseconds, or 0 if profiling is off.
+uint64_t profile_now(void) {
+    if (!enabled) {
+        return 0;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// This function charges the time since start to phase.
+// This function takes in as parameters profile_phase phase and uint64_t start which is a time returned by
+// profile_now() or profile_lap().
+// This function returns the current time, which is the start of whatever phase follows.
+uint64_t profile_lap(profile_phase phase, uint64_t start) {
+    if (!enabled) {
+        return 0;
+    }
+    uint64_t now = profile_now();
+    atomic_fetch_add_explicit(&phase_ns[phase], now - start, memory_order_relaxed);
+    return now;
+}
+
+// This function records the latency of one block in the histogram.
+// This function takes in as parameters uint64_t start and uint64_t end which are times returned by profile_now()
+// or profile_lap().
+void profile_block(uint64_t start, uint64_t end) {
+    if (!enabled) {
+        return;
+    }
+    uint64_t ns = end - start;
+    atomic_fetch_add_explicit(&histogram[bucket_of(ns)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&blocks, 1, memory_order_relaxed);
+    uint64_t max = atomic_load_explicit(&max_ns, memory_order_relaxed);
+    while (ns > max && !atomic_compare_exchange_weak_explicit(&max_ns, &max, ns, memory_order_relaxed,
+                           memory_order_relaxed)) {
+    }
+}
+
+// This function prints the time spent in each phase, the block latency percentiles, and the hardware counters
+// if they were opened, either as a table or as a single line of JSON.
+// This function takes in as parameters FILE *outfile and bool json.
+void profile_print(FILE *outfile, bool json) {
+    if (!enabled) {
+        return;
+    }
+    uint64_t wall = profile_now() - started;
+    uint64_t cycles = counter_read(cycles_fd);
+    uint64_t instructions = counter_read(instructions_fd);
+
+    if (json) {
+        fprintf(outfile, "{\"wall_ns\":%" PRIu64 ",\"phases\":{", wall);
+        for (int i = 0; i < PROFILE_PHASES; i++) {
+            fprintf(outfile, "%s\"%s_ns\":%" PRIu64, i == 0 ? "" : ",", phase_names[i], atomic_load(&phase_ns[i]));
+        }
+        fprintf(outfile,
+            "},\"blocks\":{\"count\":%" PRIu64 ",\"p50_ns\":%" PRIu64 ",\"p90_ns\":%" PRIu64 ",\"p99_ns\":%" PRIu64
+            ",\"max_ns\":%" PRIu64 "}",
+            atomic_load(&blocks), percentile(0.50), percentile(0.90), percentile(0.99), atomic_load(&max_ns));
+        if (cycles_fd >= 0 || instructions_fd >= 0) {
+            fprintf(outfile, ",\"cycles\":%" PRIu64 ",\"instructions\":%" PRIu64, cycles, instructions);
+        }
+        fprintf(outfile, "}\n");
+        return;
+    }
+
+    fprintf(outfile, "wall          %12.3f ms\n", wall / 1e6);
+    for (int i = 0; i < PROFILE_PHASES; i++) {
+        fprintf(outfile, "%-13s %12.3f ms\n", phase_names[i], atomic_load(&phase_ns[i]) / 1e6);
+    }
+    fprintf(outfile, "blocks        %12" PRIu64 "\n", atomic_load(&blocks));
+    fprintf(outfile, "block p50     %12.3f us\n", percentile(0.50) / 1e3);
+    fprintf(outfile, "block p90     %12.3f us\n", percentile(0.90) / 1e3);
+    fprintf(outfile, "block p99     %12.3f us\n", percentile(0.99) / 1e3);
+    fprintf(outfile, "block max     %12.3f us\n", atomic_load(&max_ns) / 1e3);
+    if (cycles_fd >= 0 || instructions_fd >= 0) {
+        fprintf(outfile, "cycles        %12" PRIu64 "\n", cycles);
+        fprintf(outfile, "instructions  %12" PRIu64 "\n", instructions);
+    }
+}
+
+// This function closes the hardware counters and turns profiling off.
+void profile_clear(void) {
+    if (cycles_fd >= 0) {
+        close(cycles_fd);
+    }
+    if (instructions_fd >= 0) {
+        close(instructions_fd);
+    }
+    cycles_fd = -1;
+    instructions_fd = -1;
+    enabled = false;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef enum {
+    PROFILE_INPUT,
+    PROFILE_CONVERT,
+    PROFILE_EXPONENTIATE,
+    PROFILE_OUTPUT,
+    PROFILE_PHASES
+} profile_phase;
+
+void profile_init(bool counters);
+
+uint64_t profile_now(void);
+
+uint64_t profile_lap(profile_phase phase, uint64_t start);
+
+void profile_block(uint64_t start, uint64_t end);
+
+void profile_print(FILE *outfile, bool json);
+
+void profile_clear(void);
@@ -1,4 +1,6 @@
+#include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include "randstate.h"
 #include "gmp.h"
 
@@ -16,3 +18,26 @@ void randstate_init(uint64_t seed) {
 void randstate_clear(void) {
     gmp_randclear(state);
 }
+
+// This function initializes the global random state named state like randstate_init(), but seeds it with
+// 256 bits from /dev/urandom so that the numbers it produces cannot be guessed or reproduced.
+// This function returns false if /dev/urandom could not be read, in which case state is not initialized.
+bool randstate_init_urandom(void) {
+    unsigned char bytes[32];
+    FILE *urandom = fopen("/dev/urandom", "rb");
+    if (urandom == NULL) {
+        return false;
+    }
+    size_t got = fread(bytes, sizeof(unsigned char), sizeof(bytes), urandom);
+    fclose(urandom);
+    if (got != sizeof(bytes)) {
+        return false;
+    }
+    mpz_t seed;
+    mpz_init(seed);
+    mpz_import(seed, sizeof(bytes), 1, sizeof(unsigned char), 0, 0, bytes);
+    gmp_randinit_mt(state);
+    gmp_randseed(state, seed);
+    mpz_clear(seed);
+    return true;
+}
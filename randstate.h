@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <gmp.h>
 
@@ -7,4 +8,6 @@ extern gmp_randstate_t state;
 
 void randstate_init(uint64_t seed);
 
+bool randstate_init_urandom(void);
+
 void randstate_clear(void);
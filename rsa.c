@@ -1,21 +1,30 @@
 #include "rsa.h"
+#include "fixedmod.h"
+#include "hex.h"
+#include "lz.h"
 #include "numtheory.h"
+#include "primepool.h"
+#include "profile.h"
 #include "randstate.h"
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
 #include <time.h>
 #include <gmp.h>
 
-// This function creates parts of a new RSA public key including two large primes p and q, their product n,
-// and the public exponent e.
-// This function takes in as parameters mpz_t p, mpz_t q, mpz_t n, mpz_t e, uint64_t nbits, and uint64_t iters.
-void rsa_make_pub(mpz_t p, mpz_t q, mpz_t n, mpz_t e, uint64_t nbits, uint64_t iters) {
-    uint64_t pbits = (random() % (2 * nbits / 4)) + (nbits / 4);
-    uint64_t qbits = nbits - pbits;
-    make_prime(p, pbits, iters);
-    make_prime(q, qbits, iters);
+// Small primes below this bound that divide the totient are collected once per key, so that candidates for e
+// sharing one of them are rejected with a single word division instead of a full gcd().
+#define SMALL_PRIME_BOUND 1024
+
+// This function computes the public modulus n from the primes p and q and picks a public exponent e of nbits
+// bits that is coprime with the totient of n.
+// This function takes in as parameters mpz_t p, mpz_t q, mpz_t n, mpz_t e, and uint64_t nbits.
+static void rsa_make_exponent(mpz_t p, mpz_t q, mpz_t n, mpz_t e, uint64_t nbits) {
     mpz_mul(n, p, q);
 
     mpz_t p_minus_one;
@@ -28,12 +37,36 @@ void rsa_make_pub(mpz_t p, mpz_t q, mpz_t n, mpz_t e, uint64_t nbits, uint64_t i
     mpz_init(totient);
     mpz_mul(totient, p_minus_one, q_minus_one);
 
+    // Collecting the small primes dividing the totient by trial division. A composite divisor of the totient
+    // is skipped because its smallest prime factor also divides the totient and is already in factors.
+    unsigned long factors[SMALL_PRIME_BOUND];
+    size_t num_factors = 0;
+    for (unsigned long f = 2; f < SMALL_PRIME_BOUND; f++) {
+        bool is_small_prime = true;
+        for (size_t j = 0; j < num_factors && is_small_prime && factors[j] * factors[j] <= f; j++) {
+            is_small_prime = f % factors[j] != 0;
+        }
+        if (is_small_prime && mpz_divisible_ui_p(totient, f)) {
+            factors[num_factors++] = f;
+        }
+    }
+
     mpz_t gcd_e_totient;
     mpz_init(gcd_e_totient);
-    do {
+    while (true) {
         mpz_urandomb(e, state, nbits);
+        bool shares_small_factor = false;
+        for (size_t j = 0; j < num_factors && !shares_small_factor; j++) {
+            shares_small_factor = mpz_divisible_ui_p(e, factors[j]);
+        }
+        if (shares_small_factor) {
+            continue;
+        }
         gcd(gcd_e_totient, e, totient);
-    } while (mpz_cmp_ui(gcd_e_totient, 1) > 0);
+        if (mpz_cmp_ui(gcd_e_totient, 1) <= 0) {
+            break;
+        }
+    }
 
     mpz_clear(p_minus_one);
     mpz_clear(q_minus_one);
@@ -41,21 +74,56 @@ void rsa_make_pub(mpz_t p, mpz_t q, mpz_t n, mpz_t e, uint64_t nbits, uint64_t i
     mpz_clear(gcd_e_totient);
 }
 
+// This function creates parts of a new RSA public key including two large primes p and q, their product n,
+// and the public exponent e.
+// This function takes in as parameters mpz_t p, mpz_t q, mpz_t n, mpz_t e, uint64_t nbits, and uint64_t iters.
+void rsa_make_pub(mpz_t p, mpz_t q, mpz_t n, mpz_t e, uint64_t nbits, uint64_t iters) {
+    uint64_t pbits = (random() % (2 * nbits / 4)) + (nbits / 4);
+    uint64_t qbits = nbits - pbits;
+    make_prime(p, pbits, iters);
+    make_prime(q, qbits, iters);
+    rsa_make_exponent(p, q, n, e, nbits);
+}
+
+// This function creates parts of a new RSA public key like rsa_make_pub(), but takes the primes p and q from
+// the prime pool when it has them. The bits are split evenly between p and q so that the pool buckets filled
+// by primegen match, and make_prime() is only called for a prime the pool could not supply.
+// This function takes in as parameters mpz_t p, mpz_t q, mpz_t n, mpz_t e, uint64_t nbits, uint64_t iters,
+// and const char *poolname which is the prime pool file.
+// This function returns false if the pool could not be claimed from, in which case no key was made.
+bool rsa_make_pub_pool(mpz_t p, mpz_t q, mpz_t n, mpz_t e, uint64_t nbits, uint64_t iters, const char *poolname) {
+    uint64_t pbits = nbits / 2;
+    uint64_t qbits = nbits - pbits;
+    bool got_p;
+    bool got_q;
+    if (!pool_claim(poolname, p, pbits, &got_p, q, qbits, &got_q)) {
+        return false;
+    }
+    if (!got_p) {
+        make_prime(p, pbits, iters);
+    }
+    if (!got_q) {
+        make_prime(q, qbits, iters);
+    }
+    rsa_make_exponent(p, q, n, e, nbits);
+    return true;
+}
+
 // This function writes a public RSA key to pbfile.
 // This function takes in as parameters mpz_t n, mpz_t e, mpz_t s, char username[], and a FILE *pbfile.
 void rsa_write_pub(mpz_t n, mpz_t e, mpz_t s, char username[], FILE *pbfile) {
-    gmp_fprintf(pbfile, "%Zx\n", n);
-    gmp_fprintf(pbfile, "%Zx\n", e);
-    gmp_fprintf(pbfile, "%Zx\n", s);
+    hex_write(pbfile, n);
+    hex_write(pbfile, e);
+    hex_write(pbfile, s);
     fprintf(pbfile, "%s\n", username);
 }
 
 // This function reads a public RSA key from pbfile.
 // This function takes in as parameters mpz_t n, mpz_t e, mpz_t s, char username[], and FILE *pbfile.
 void rsa_read_pub(mpz_t n, mpz_t e, mpz_t s, char username[], FILE *pbfile) {
-    gmp_fscanf(pbfile, "%Zx\n", n);
-    gmp_fscanf(pbfile, "%Zx\n", e);
-    gmp_fscanf(pbfile, "%Zx\n", s);
+    hex_read(pbfile, n);
+    hex_read(pbfile, e);
+    hex_read(pbfile, s);
     fscanf(pbfile, "%s\n", username);
 }
 
@@ -83,60 +151,281 @@ void rsa_make_priv(mpz_t d, mpz_t e, mpz_t p, mpz_t q) {
 // This function writes a private RSA key to pvfile.
 // This function takes in as parameters mpz_t n, mpz_t d, and FILE *pvfile.
 void rsa_write_priv(mpz_t n, mpz_t d, FILE *pvfile) {
-    gmp_fprintf(pvfile, "%Zx\n", n);
-    gmp_fprintf(pvfile, "%Zx\n", d);
+    hex_write(pvfile, n);
+    hex_write(pvfile, d);
 }
 
 // This function reads a private RSA key from pvfile.
 // This function takes in as parameters mpz_t n, mpz_t d, and FILE *pvfile.
 void rsa_read_priv(mpz_t n, mpz_t d, FILE *pvfile) {
-    gmp_fscanf(pvfile, "%Zx\n", n);
-    gmp_fscanf(pvfile, "%Zx\n", d);
+    hex_read(pvfile, n);
+    hex_read(pvfile, d);
 }
 
 // This function performs RSA encryption, computing ciphertext c by encrypting message m using public exponent e and
 // modulus n.
+// The fixed width kernel for the size of n is used when there is one, and pow_mod() otherwise.
 // This function takes in as parameters mpz_t c, mpz_t m, mpz_t e, and mpz_t n.
 void rsa_encrypt(mpz_t c, mpz_t m, mpz_t e, mpz_t n) {
-    pow_mod(c, m, e, n);
+    if (fixed_pow_mod(c, m, e, n) == false) {
+        pow_mod(c, m, e, n);
+    }
 }
 
-// This function encrypts the contents of infile, writing the encrypted contents to outfile.
-// This function takes in as parameters FILE *infile, FILE *outfile, mpz_t n, and mpz_t e.
-void rsa_encrypt_file(FILE *infile, FILE *outfile, mpz_t n, mpz_t e) {
-    size_t k = (mpz_sizeinbase(n, 2) - 1) / 8;
-
-    uint8_t *array = (uint8_t *) calloc(k, sizeof(uint8_t));
+// Bytes of input read at a time when encrypting for several recipients. Each segment is chunked and
+// encrypted for every recipient in parallel before the next one is read.
+#define SEGMENT_BYTES (1 << 18)
 
-    array[0] = 0xFF;
+// The first byte of every block is a marker that keeps the block's leading bytes from being lost as zeros.
+// Blocks that carry a compressed stream are marked with PAD_COMPRESSED instead of PAD_PLAIN.
+#define PAD_PLAIN      0xFF
+#define PAD_COMPRESSED 0xFE
 
-    size_t j;
+// The state of encrypting one input for one recipient: the recipient's key and output, the block being filled,
+// and the segment of input currently being chunked into blocks.
+typedef struct {
+    FILE *outfile;
+    mpz_ptr n;
+    mpz_ptr e;
+    size_t k;
+    uint8_t *array;
+    size_t fill;
     mpz_t m;
-    mpz_init(m);
     mpz_t c;
-    mpz_init(c);
-    while (feof(infile) == 0) {
-        j = fread(array + 1, sizeof(uint8_t), k - 1, infile);
-        mpz_import(m, j + 1, 1, sizeof(uint8_t), 1, 0, array);
-        rsa_encrypt(c, m, e, n);
-        gmp_fprintf(outfile, "%Zx\n", c);
+    const uint8_t *segment;
+    size_t segment_len;
+    bool last;
+} recipient;
+
+// This function sets up a recipient encrypting with the public key n and e into outfile.
+// This function takes in as parameters recipient *r, FILE *outfile, mpz_t n, mpz_t e, and bool compress which is
+// whether the blocks will carry a compressed stream.
+static void recipient_init(recipient *r, FILE *outfile, mpz_t n, mpz_t e, bool compress) {
+    r->outfile = outfile;
+    r->n = n;
+    r->e = e;
+    r->k = (mpz_sizeinbase(n, 2) - 1) / 8;
+    r->array = (uint8_t *) calloc(r->k, sizeof(uint8_t));
+    r->array[0] = compress ? PAD_COMPRESSED : PAD_PLAIN;
+    r->fill = 0;
+    mpz_init(r->m);
+    mpz_init(r->c);
+}
+
+// This function frees the memory used by a recipient.
+// This function takes in as a parameter recipient *r.
+static void recipient_clear(recipient *r) {
+    mpz_clear(r->m);
+    mpz_clear(r->c);
+    free(r->array);
+}
+
+// This function encrypts the block filled so far for a recipient and writes it to the recipient's outfile.
+// This function takes in as a parameter recipient *r.
+static void recipient_block(recipient *r) {
+    uint64_t start = profile_now();
+    mpz_import(r->m, r->fill + 1, 1, sizeof(uint8_t), 1, 0, r->array);
+    uint64_t lap = profile_lap(PROFILE_CONVERT, start);
+    rsa_encrypt(r->c, r->m, r->e, r->n);
+    lap = profile_lap(PROFILE_EXPONENTIATE, lap);
+    hex_write(r->outfile, r->c);
+    profile_block(start, profile_lap(PROFILE_OUTPUT, lap));
+    r->fill = 0;
+}
+
+// This function chunks the current segment into blocks of k - 1 bytes for a recipient, encrypting every block
+// that fills up. After the last segment, the remaining bytes are encrypted as a final, possibly empty, block,
+// which matches how the blocks are laid out when reading the input k - 1 bytes at a time.
+// This function takes in as a parameter void *arg which is the recipient, so that it can run as a thread.
+// This function returns NULL.
+static void *recipient_feed(void *arg) {
+    recipient *r = (recipient *) arg;
+    size_t offset = 0;
+    while (offset < r->segment_len) {
+        size_t take = r->k - 1 - r->fill;
+        if (take > r->segment_len - offset) {
+            take = r->segment_len - offset;
+        }
+        memcpy(r->array + 1 + r->fill, r->segment + offset, take);
+        r->fill += take;
+        offset += take;
+        if (r->fill == r->k - 1) {
+            recipient_block(r);
+        }
     }
+    if (r->last) {
+        recipient_block(r);
+    }
+    return NULL;
+}
 
-    mpz_clear(m);
-    mpz_clear(c);
-    free(array);
+// The workers that encrypt each segment for several recipients. A fixed number of them is started for the
+// whole input, and for every segment they claim recipients one at a time until each has been fed the segment.
+typedef struct {
+    recipient *recipients;
+    size_t count;
+    atomic_size_t next;
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    uint64_t generation;
+    size_t busy;
+    bool stop;
+} segment_pool;
+
+// This function is the loop of a segment worker, which waits for a new segment, feeds it to the recipients it
+// claims, and reports when it has run out of recipients.
+// This function takes in as a parameter void *arg which is the segment_pool.
+// This function returns NULL.
+static void *segment_worker(void *arg) {
+    segment_pool *pool = (segment_pool *) arg;
+    uint64_t seen = 0;
+    pthread_mutex_lock(&pool->lock);
+    while (true) {
+        while (pool->generation == seen && !pool->stop) {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+        if (pool->stop) {
+            break;
+        }
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        size_t i;
+        while ((i = atomic_fetch_add(&pool->next, 1)) < pool->count) {
+            recipient_feed(&pool->recipients[i]);
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->busy == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+// This function reads infile once, one segment at a time, and encrypts each segment for every recipient.
+// A single recipient reads k - 1 bytes at a time so that blocks are written as soon as their input arrives.
+// Several recipients are shared out among one worker per online CPU. When compressing, each segment is one
+// frame of input and the recipients are given the compressed frame instead.
+// This function takes in as parameters FILE *infile, recipient *recipients, size_t count, and bool compress.
+static void encrypt_segments(FILE *infile, recipient *recipients, size_t count, bool compress) {
+    size_t segment_bytes = compress ? LZ_FRAME_BYTES : count == 1 ? recipients[0].k - 1 : SEGMENT_BYTES;
+    uint8_t *segment = (uint8_t *) calloc(segment_bytes, sizeof(uint8_t));
+    uint8_t *frame = compress ? (uint8_t *) calloc(lz_frame_bound(segment_bytes), sizeof(uint8_t)) : NULL;
+
+    // Starting the workers. If fewer threads could be created than asked for, the rest of the work is shared
+    // among those that were, and with none at all the recipients are fed one after another on this thread.
+    segment_pool pool = { .recipients = recipients, .count = count };
+    atomic_init(&pool.next, 0);
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.start, NULL);
+    pthread_cond_init(&pool.done, NULL);
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t workers = count == 1 ? 0 : cpus < 1 ? 1 : (size_t) cpus;
+    if (workers > count) {
+        workers = count;
+    }
+    pthread_t *threads = (pthread_t *) calloc(workers + 1, sizeof(pthread_t));
+    size_t started = 0;
+    while (started < workers && pthread_create(&threads[started], NULL, segment_worker, &pool) == 0) {
+        started++;
+    }
+
+    bool last = false;
+    while (!last) {
+        uint64_t start = profile_now();
+        size_t len = fread(segment, sizeof(uint8_t), segment_bytes, infile);
+        last = feof(infile) != 0 || ferror(infile) != 0;
+        const uint8_t *data = segment;
+        if (compress) {
+            data = frame;
+            len = len == 0 ? 0 : lz_compress_frame(frame, segment, len);
+        }
+        profile_lap(PROFILE_INPUT, start);
+
+        for (size_t i = 0; i < count; i++) {
+            recipients[i].segment = data;
+            recipients[i].segment_len = len;
+            recipients[i].last = last;
+        }
+        if (started == 0) {
+            for (size_t i = 0; i < count; i++) {
+                recipient_feed(&recipients[i]);
+            }
+        } else {
+            pthread_mutex_lock(&pool.lock);
+            atomic_store(&pool.next, 0);
+            pool.busy = started;
+            pool.generation++;
+            pthread_cond_broadcast(&pool.start);
+            while (pool.busy > 0) {
+                pthread_cond_wait(&pool.done, &pool.lock);
+            }
+            pthread_mutex_unlock(&pool.lock);
+        }
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    pool.stop = true;
+    pthread_cond_broadcast(&pool.start);
+    pthread_mutex_unlock(&pool.lock);
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_mutex_destroy(&pool.lock);
+    pthread_cond_destroy(&pool.start);
+    pthread_cond_destroy(&pool.done);
+
+    free(segment);
+    free(frame);
+    free(threads);
+}
+
+// This function encrypts the contents of infile, writing the encrypted contents to outfile.
+// This function takes in as parameters FILE *infile, FILE *outfile, mpz_t n, and mpz_t e.
+void rsa_encrypt_file(FILE *infile, FILE *outfile, mpz_t n, mpz_t e) {
+    recipient r;
+    recipient_init(&r, outfile, n, e, false);
+    encrypt_segments(infile, &r, 1, false);
+    recipient_clear(&r);
+}
+
+// This function encrypts the contents of infile for several recipients, reading infile only once and writing
+// what rsa_encrypt_file() would have written for public key n[i] and e[i] to outfiles[i]. If compress is set,
+// the contents are compressed before they are split into blocks, and the blocks are marked so that
+// rsa_decrypt_file() decompresses them.
+// This function takes in as parameters FILE *infile, FILE *outfiles[], mpz_t n[], mpz_t e[], size_t count
+// which is the number of recipients, and bool compress.
+void rsa_encrypt_file_multi(FILE *infile, FILE *outfiles[], mpz_t n[], mpz_t e[], size_t count, bool compress) {
+    recipient *recipients = (recipient *) calloc(count, sizeof(recipient));
+    for (size_t i = 0; i < count; i++) {
+        recipient_init(&recipients[i], outfiles[i], n[i], e[i], compress);
+    }
+    encrypt_segments(infile, recipients, count, compress);
+    for (size_t i = 0; i < count; i++) {
+        recipient_clear(&recipients[i]);
+    }
+    free(recipients);
 }
 
 // This function performs RSA decryption, computing message m by decrypting ciphertext c using private key d and
 // public modulus n.
+// The fixed width kernel for the size of n is used when there is one, and pow_mod() otherwise.
 // This function takes in as parameters mpz_t m, mpz_t c, mpz_t d, and mpz_t n.
 void rsa_decrypt(mpz_t m, mpz_t c, mpz_t d, mpz_t n) {
-    pow_mod(m, c, d, n);
+    if (fixed_pow_mod(m, c, d, n) == false) {
+        pow_mod(m, c, d, n);
+    }
 }
 
-// This function decrypts the contents of infile, writing the decrypted contents to outfile.
+// This function decrypts the contents of infile, writing the decrypted contents to outfile. Blocks marked as
+// carrying a compressed stream are decompressed on the way out.
 // This function takes in as parameters FILE *infile, FILE *outfile, mpz_t n, and mpz_t d.
-void rsa_decrypt_file(FILE *infile, FILE *outfile, mpz_t n, mpz_t d) {
+// This function returns false, after printing an error, if a line of infile was not a hexadecimal number or the
+// compressed stream was corrupt. Decryption stops at the first such line or frame.
+bool rsa_decrypt_file(FILE *infile, FILE *outfile, mpz_t n, mpz_t d) {
     size_t k = (mpz_sizeinbase(n, 2) - 1) / 8;
 
     uint8_t *array = (uint8_t *) calloc(k, sizeof(uint8_t));
@@ -146,18 +435,49 @@ void rsa_decrypt_file(FILE *infile, FILE *outfile, mpz_t n, mpz_t d) {
     mpz_t m;
     mpz_init(m);
     size_t j;
-    while (feof(infile) == 0) {
-        gmp_fscanf(infile, "%Zx\n", c);
+    lz_decoder dec;
+    bool compressed = false;
+    bool ok = true;
+    size_t line = 0;
+    while (ok && hex_more(infile)) {
+        uint64_t start = profile_now();
+        line++;
+        if (hex_read(infile, c) == false) {
+            fprintf(stderr, "Error: line %zu of the encrypted data is not a hexadecimal number.\n", line);
+            ok = false;
+            break;
+        }
+        uint64_t lap = profile_lap(PROFILE_INPUT, start);
         if (mpz_cmp_ui(c, 0) > 0) {
             rsa_decrypt(m, c, d, n);
+            lap = profile_lap(PROFILE_EXPONENTIATE, lap);
             mpz_export(array, &j, 1, sizeof(uint8_t), 1, 0, m);
-            fwrite(array + 1, sizeof(uint8_t), j - 1, outfile);
+            lap = profile_lap(PROFILE_CONVERT, lap);
+            if (array[0] == PAD_COMPRESSED && !compressed) {
+                lz_decoder_init(&dec);
+                compressed = true;
+            }
+            if (compressed && !lz_decoder_feed(&dec, array + 1, j - 1, outfile)) {
+                fprintf(stderr, "Error: the compressed data is corrupt.\n");
+                ok = false;
+            } else if (!compressed) {
+                fwrite(array + 1, sizeof(uint8_t), j - 1, outfile);
+            }
+            profile_block(start, profile_lap(PROFILE_OUTPUT, lap));
         }
     }
 
+    if (compressed) {
+        if (ok && !lz_decoder_finish(&dec)) {
+            fprintf(stderr, "Error: the compressed data is corrupt.\n");
+            ok = false;
+        }
+        lz_decoder_clear(&dec);
+    }
     mpz_clear(c);
     mpz_clear(m);
     free(array);
+    return ok;
 }
 
 // This function performs RSA signing, producing signature s by signing message m using private key d and public
@@ -182,3 +502,104 @@ bool rsa_verify(mpz_t m, mpz_t s, mpz_t e, mpz_t n) {
         return false;
     }
 }
+
+// Bits of the random exponents that weight each signature in a batch. A batch holding a signature forged
+// without the private key passes with probability about 2^-BATCH_EXPONENT_BITS. A valid signature multiplied
+// by a square root of 1 modulo n, such as n - s, only has the parity of its exponent to catch it, so it
+// passes with probability 1/2.
+#define BATCH_EXPONENT_BITS 64
+
+// This function screens signatures lo to hi - 1 together, splitting the range in half and screening each half
+// whenever the range as a whole fails, until every bad signature is found on its own.
+// This function takes in as parameters mpz_t m[], mpz_t s[], size_t lo, size_t hi, mpz_t e, mpz_t n,
+// and bool valid[] which is where the result for each signature is stored.
+static void rsa_verify_range(mpz_t m[], mpz_t s[], size_t lo, size_t hi, mpz_t e, mpz_t n, bool valid[]) {
+    if (hi - lo == 1) {
+        valid[lo] = rsa_verify(m[lo], s[lo], e, n);
+        return;
+    }
+
+    mpz_t r;
+    mpz_init(r);
+    mpz_t t;
+    mpz_init(t);
+    mpz_t s_product;
+    mpz_init_set_ui(s_product, 1);
+    mpz_t m_product;
+    mpz_init_set_ui(m_product, 1);
+    for (size_t i = lo; i < hi; i++) {
+        do {
+            mpz_urandomb(r, state, BATCH_EXPONENT_BITS);
+        } while (mpz_cmp_ui(r, 0) == 0);
+        pow_mod(t, s[i], r, n);
+        mpz_mul(s_product, s_product, t);
+        mpz_mod(s_product, s_product, n);
+        pow_mod(t, m[i], r, n);
+        mpz_mul(m_product, m_product, t);
+        mpz_mod(m_product, m_product, n);
+    }
+    bool passed = rsa_verify(m_product, s_product, e, n);
+
+    mpz_clear(r);
+    mpz_clear(t);
+    mpz_clear(s_product);
+    mpz_clear(m_product);
+
+    if (passed) {
+        for (size_t i = lo; i < hi; i++) {
+            valid[i] = true;
+        }
+    } else {
+        size_t mid = lo + (hi - lo) / 2;
+        rsa_verify_range(m, s, lo, mid, e, n, valid);
+        rsa_verify_range(m, s, mid, hi, e, n, valid);
+    }
+}
+
+// This function screens a batch of signatures made with the same key, checking that the product of every
+// s[i]^(e * r[i]) equals the product of every m[i]^r[i] modulo n for random small exponents r[i]. That takes a
+// single exponentiation by e for the whole batch instead of one per signature. If the batch fails, it is
+// bisected to find the bad signatures, which are confirmed with rsa_verify(). Like any batch test for RSA,
+// this screens that each message was signed by the holder of the private key, not that each signature is the
+// exact value rsa_sign() would produce. The random state must be initialized.
+// This function takes in as parameters mpz_t m[], mpz_t s[], size_t count, mpz_t e, mpz_t n, and bool valid[]
+// which is where the result for each signature is stored.
+// This function returns true if every signature passed, and false otherwise.
+bool rsa_verify_batch(mpz_t m[], mpz_t s[], size_t count, mpz_t e, mpz_t n, bool valid[]) {
+    // Messages and signatures that are not reduced modulo n can never verify on their own, so they are
+    // rejected before they can be folded into a product that hides them.
+    size_t *order = (size_t *) calloc(count, sizeof(size_t));
+    mpz_t *m_reduced = (mpz_t *) calloc(count, sizeof(mpz_t));
+    mpz_t *s_reduced = (mpz_t *) calloc(count, sizeof(mpz_t));
+    size_t reduced = 0;
+    for (size_t i = 0; i < count; i++) {
+        valid[i] = false;
+        if (mpz_sgn(m[i]) >= 0 && mpz_cmp(m[i], n) < 0 && mpz_sgn(s[i]) >= 0 && mpz_cmp(s[i], n) < 0) {
+            order[reduced] = i;
+            mpz_init_set(m_reduced[reduced], m[i]);
+            mpz_init_set(s_reduced[reduced], s[i]);
+            reduced++;
+        }
+    }
+
+    bool *reduced_valid = (bool *) calloc(count, sizeof(bool));
+    if (reduced > 0) {
+        rsa_verify_range(m_reduced, s_reduced, 0, reduced, e, n, reduced_valid);
+    }
+
+    bool all_valid = true;
+    for (size_t i = 0; i < reduced; i++) {
+        valid[order[i]] = reduced_valid[i];
+        mpz_clear(m_reduced[i]);
+        mpz_clear(s_reduced[i]);
+    }
+    for (size_t i = 0; i < count; i++) {
+        all_valid = all_valid && valid[i];
+    }
+
+    free(order);
+    free(m_reduced);
+    free(s_reduced);
+    free(reduced_valid);
+    return all_valid;
+}
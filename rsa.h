@@ -7,6 +7,8 @@
 
 void rsa_make_pub(mpz_t p, mpz_t q, mpz_t n, mpz_t e, uint64_t nbits, uint64_t iters);
 
+bool rsa_make_pub_pool(mpz_t p, mpz_t q, mpz_t n, mpz_t e, uint64_t nbits, uint64_t iters, const char *poolname);
+
 void rsa_write_pub(mpz_t n, mpz_t e, mpz_t s, char username[], FILE *pbfile);
 
 void rsa_read_pub(mpz_t n, mpz_t e, mpz_t s, char username[], FILE *pbfile);
@@ -21,10 +23,14 @@ void rsa_encrypt(mpz_t c, mpz_t m, mpz_t e, mpz_t n);
 
 void rsa_encrypt_file(FILE *infile, FILE *outfile, mpz_t n, mpz_t e);
 
+void rsa_encrypt_file_multi(FILE *infile, FILE *outfiles[], mpz_t n[], mpz_t e[], size_t count, bool compress);
+
 void rsa_decrypt(mpz_t m, mpz_t c, mpz_t d, mpz_t n);
 
-void rsa_decrypt_file(FILE *infile, FILE *outfile, mpz_t n, mpz_t d);
+bool rsa_decrypt_file(FILE *infile, FILE *outfile, mpz_t n, mpz_t d);
 
 void rsa_sign(mpz_t s, mpz_t m, mpz_t d, mpz_t n);
 
 bool rsa_verify(mpz_t m, mpz_t s, mpz_t e, mpz_t n);
+
+bool rsa_verify_batch(mpz_t m[], mpz_t s[], size_t count, mpz_t e, mpz_t n, bool valid[]);
@@ -0,0 +1,478 @@
+#include "rsa_async.h"
+#include "rsa.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <gmp.h>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+typedef enum {
+    OP_ENCRYPT,
+    OP_DECRYPT,
+    OP_SIGN,
+    OP_VERIFY
+} job_op;
+
+// A job moves from QUEUED to either RUNNING and then DONE, or straight to CANCELLED. Whichever of a worker and
+// rsa_async_cancel() swaps the state out of QUEUED first decides which.
+enum {
+    JOB_QUEUED,
+    JOB_RUNNING,
+    JOB_DONE,
+    JOB_CANCELLED
+};
+
+struct rsa_job {
+    rsa_async *pool;
+    job_op op;
+    mpz_t input;
+    mpz_t key;
+    mpz_t n;
+    mpz_t message;
+    mpz_t result;
+    bool verified;
+    rsa_async_callback callback;
+    void *arg;
+    atomic_int state;
+    atomic_int refs;
+    rsa_job *prev;
+    rsa_job *next;
+};
+
+// A doubly linked list of jobs under its own lock. Each worker owns one as its queue, which it and any idle
+// worker stealing from it both take from the front, so that no job waits behind ones submitted after it. The
+// pool keeps another of completions.
+typedef struct {
+    pthread_mutex_t lock;
+    rsa_job *head;
+    rsa_job *tail;
+} job_list;
+
+typedef struct {
+    rsa_async *pool;
+    size_t index;
+    pthread_t thread;
+    job_list queue;
+} worker;
+
+struct rsa_async {
+    worker *workers;
+    size_t num_workers;
+    size_t started;
+    size_t max_jobs;
+    atomic_size_t outstanding;
+    atomic_size_t next_worker;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    size_t queued;
+    bool stopping;
+    job_list completed;
+    pthread_cond_t completion;
+    int notify_read;
+    int notify_write;
+};
+
+// This function sets up an empty job list.
+// This function takes in as a parameter job_list *list.
+static void list_init(job_list *list) {
+    pthread_mutex_init(&list->lock, NULL);
+    list->head = NULL;
+    list->tail = NULL;
+}
+
+// This function appends a job to the back of a list. The caller must hold the list's lock.
+// This function takes in as parameters job_list *list and rsa_job *job.
+static void list_push(job_list *list, rsa_job *job) {
+    job->next = NULL;
+    job->prev = list->tail;
+    if (list->tail != NULL) {
+        list->tail->next = job;
+    } else {
+        list->head = job;
+    }
+    list->tail = job;
+}
+
+// This function removes the oldest job from a list. The caller must hold the list's lock.
+// This function takes in as a parameter job_list *list.
+// This function returns the job, or NULL if the list is empty.
+static rsa_job *list_take(job_list *list) {
+    rsa_job *job = list->head;
+    if (job == NULL) {
+        return NULL;
+    }
+    if (job->prev != NULL) {
+        job->prev->next = job->next;
+    } else {
+        list->head = job->next;
+    }
+    if (job->next != NULL) {
+        job->next->prev = job->prev;
+    } else {
+        list->tail = job->prev;
+    }
+    return job;
+}
+
+// This function hands a finished or cancelled job to its callback and then drops the pool's reference to it,
+// or queues it for rsa_async_poll() and wakes up the notification descriptor and any thread in
+// rsa_async_wait().
+// This function takes in as a parameter rsa_job *job.
+static void deliver(rsa_job *job) {
+    rsa_async *pool = job->pool;
+    if (job->callback != NULL) {
+        job->callback(job, job->arg);
+        rsa_job_free(job);
+        return;
+    }
+    pthread_mutex_lock(&pool->completed.lock);
+    list_push(&pool->completed, job);
+    pthread_cond_signal(&pool->completion);
+    pthread_mutex_unlock(&pool->completed.lock);
+
+    uint64_t one = 1;
+    ssize_t written = write(pool->notify_write, &one, pool->notify_read == pool->notify_write ? sizeof(one) : 1);
+    (void) written;
+}
+
+// This function runs a job unless it was cancelled first, and delivers it either way.
+// This function takes in as a parameter rsa_job *job.
+static void run(rsa_job *job) {
+    int queued = JOB_QUEUED;
+    if (atomic_compare_exchange_strong(&job->state, &queued, JOB_RUNNING)) {
+        switch (job->op) {
+        case OP_ENCRYPT: rsa_encrypt(job->result, job->input, job->key, job->n); break;
+        case OP_DECRYPT: rsa_decrypt(job->result, job->input, job->key, job->n); break;
+        case OP_SIGN: rsa_sign(job->result, job->input, job->key, job->n); break;
+        case OP_VERIFY: job->verified = rsa_verify(job->message, job->input, job->key, job->n); break;
+        }
+        atomic_store(&job->state, JOB_DONE);
+    }
+    deliver(job);
+}
+
+// This function takes the next job for a worker: the oldest in its own queue, or else the oldest in another
+// worker's queue.
+// This function takes in as a parameter worker *self.
+// This function returns the job, or NULL if every queue is empty.
+static rsa_job *take(worker *self) {
+    rsa_async *pool = self->pool;
+    for (size_t i = 0; i < pool->num_workers; i++) {
+        worker *victim = &pool->workers[(self->index + i) % pool->num_workers];
+        pthread_mutex_lock(&victim->queue.lock);
+        rsa_job *job = list_take(&victim->queue);
+        pthread_mutex_unlock(&victim->queue.lock);
+        if (job != NULL) {
+            pthread_mutex_lock(&pool->lock);
+            pool->queued--;
+            pthread_mutex_unlock(&pool->lock);
+            return job;
+        }
+    }
+    return NULL;
+}
+
+// This function is the loop of a worker thread, which runs jobs until the pool is stopped and sleeps while
+// there are none queued anywhere.
+// This function takes in as a parameter void *arg which is the worker.
+// This function returns NULL.
+static void *worker_loop(void *arg) {
+    worker *self = (worker *) arg;
+    rsa_async *pool = self->pool;
+    while (true) {
+        rsa_job *job = take(self);
+        if (job != NULL) {
+            run(job);
+            continue;
+        }
+        pthread_mutex_lock(&pool->lock);
+        while (pool->queued == 0 && !pool->stopping) {
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        }
+        bool stopping = pool->stopping && pool->queued == 0;
+        pthread_mutex_unlock(&pool->lock);
+        if (stopping) {
+            return NULL;
+        }
+    }
+}
+
+// This function creates a pool of worker threads that run RSA operations submitted from other threads, so
+// that the submitting thread never runs the bignum math itself.
+// This function takes in as parameters size_t workers which is the number of threads, and size_t max_jobs
+// which is how many jobs can be outstanding, from submission until they are freed, before submitting fails.
+// This function returns the pool, or NULL if its notification descriptor could not be made or no worker thread
+// could be started. If only some of the threads started, the pool runs with those.
+rsa_async *rsa_async_create(size_t workers, size_t max_jobs) {
+    rsa_async *pool = (rsa_async *) calloc(1, sizeof(rsa_async));
+#ifdef __linux__
+    pool->notify_read = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    pool->notify_write = pool->notify_read;
+    if (pool->notify_read < 0) {
+        free(pool);
+        return NULL;
+    }
+#else
+    int fds[2];
+    if (pipe(fds) != 0) {
+        free(pool);
+        return NULL;
+    }
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    pool->notify_read = fds[0];
+    pool->notify_write = fds[1];
+#endif
+    pool->num_workers = workers > 0 ? workers : 1;
+    pool->max_jobs = max_jobs;
+    atomic_init(&pool->outstanding, 0);
+    atomic_init(&pool->next_worker, 0);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->completion, NULL);
+    list_init(&pool->completed);
+
+    pool->workers = (worker *) calloc(pool->num_workers, sizeof(worker));
+    for (size_t i = 0; i < pool->num_workers; i++) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i;
+        list_init(&pool->workers[i].queue);
+    }
+    // Starting the workers. Jobs are only queued on the workers that started, and if none did, there is no
+    // pool to run them.
+    while (pool->started < pool->num_workers) {
+        worker *w = &pool->workers[pool->started];
+        if (pthread_create(&w->thread, NULL, worker_loop, w) != 0) {
+            break;
+        }
+        pool->started++;
+    }
+    if (pool->started == 0) {
+        for (size_t i = 0; i < pool->num_workers; i++) {
+            pthread_mutex_destroy(&pool->workers[i].queue.lock);
+        }
+        pthread_mutex_destroy(&pool->completed.lock);
+        pthread_mutex_destroy(&pool->lock);
+        pthread_cond_destroy(&pool->wake);
+        pthread_cond_destroy(&pool->completion);
+        close(pool->notify_read);
+        if (pool->notify_write != pool->notify_read) {
+            close(pool->notify_write);
+        }
+        free(pool->workers);
+        free(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+// This function cancels every queued job, waits for the running ones to finish, stops the workers, and frees
+// the pool along with every job not yet taken by rsa_async_poll() or rsa_async_wait(). Every other job
+// returned by a submit function must be freed with rsa_job_free() before this is called, including jobs with a
+// callback.
+// This function takes in as a parameter rsa_async *pool.
+void rsa_async_destroy(rsa_async *pool) {
+    for (size_t i = 0; i < pool->num_workers; i++) {
+        pthread_mutex_lock(&pool->workers[i].queue.lock);
+        for (rsa_job *job = pool->workers[i].queue.head; job != NULL; job = job->next) {
+            rsa_async_cancel(job);
+        }
+        pthread_mutex_unlock(&pool->workers[i].queue.lock);
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    for (size_t i = 0; i < pool->started; i++) {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+
+    rsa_job *job;
+    while ((job = list_take(&pool->completed)) != NULL) {
+        rsa_job_free(job);
+    }
+    close(pool->notify_read);
+    if (pool->notify_write != pool->notify_read) {
+        close(pool->notify_write);
+    }
+    free(pool->workers);
+    free(pool);
+}
+
+// This function returns a descriptor for an event loop to watch, which becomes readable when jobs without a
+// callback complete. After it is readable, read from it to reset it and then call rsa_async_poll() until it
+// returns NULL. On Linux it is an eventfd, elsewhere the read end of a pipe.
+// This function takes in as a parameter rsa_async *pool.
+int rsa_async_fd(rsa_async *pool) {
+    return pool->notify_read;
+}
+
+// This function creates a job and queues it on the next worker's queue in turn.
+// This function takes in as parameters rsa_async *pool, job_op op, mpz_t input, mpz_t key, mpz_t n,
+// mpz_t message which is only used for verification and may be NULL otherwise, rsa_async_callback callback,
+// and void *arg.
+// This function returns the job, or NULL if max_jobs jobs are already outstanding.
+static rsa_job *submit(rsa_async *pool, job_op op, mpz_t input, mpz_t key, mpz_t n, mpz_t message,
+    rsa_async_callback callback, void *arg) {
+    if (atomic_fetch_add(&pool->outstanding, 1) >= pool->max_jobs) {
+        atomic_fetch_sub(&pool->outstanding, 1);
+        return NULL;
+    }
+
+    rsa_job *job = (rsa_job *) calloc(1, sizeof(rsa_job));
+    job->pool = pool;
+    job->op = op;
+    mpz_init_set(job->input, input);
+    mpz_init_set(job->key, key);
+    mpz_init_set(job->n, n);
+    mpz_init(job->message);
+    if (message != NULL) {
+        mpz_set(job->message, message);
+    }
+    mpz_init(job->result);
+    job->callback = callback;
+    job->arg = arg;
+    atomic_init(&job->state, JOB_QUEUED);
+    // A job with a callback is also referenced by the pool until its callback returns, so that the caller's
+    // handle stays valid for rsa_async_cancel() however soon a worker finishes it.
+    atomic_init(&job->refs, callback != NULL ? 2 : 1);
+
+    // Counting the job before pushing it, so that a worker which takes it at once never counts below zero.
+    pthread_mutex_lock(&pool->lock);
+    pool->queued++;
+    pthread_cond_signal(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    worker *target = &pool->workers[atomic_fetch_add(&pool->next_worker, 1) % pool->started];
+    pthread_mutex_lock(&target->queue.lock);
+    list_push(&target->queue, job);
+    pthread_mutex_unlock(&target->queue.lock);
+    return job;
+}
+
+// This function submits rsa_encrypt() of message m with public exponent e and modulus n. The operands are
+// copied, so they can be changed or cleared as soon as this returns.
+// Every job returned must be freed with rsa_job_free() exactly once. A job without a callback is freed after
+// rsa_async_poll() or rsa_async_wait() has returned it. A job with a callback can be freed as soon as the
+// caller no longer needs it for rsa_async_cancel(), before or after the callback runs; the pool keeps it alive
+// until the callback has returned, and the callback itself must not free it.
+// This function takes in as parameters rsa_async *pool, mpz_t m, mpz_t e, mpz_t n, rsa_async_callback callback
+// which is called on a worker thread when the job completes, or NULL to collect it with rsa_async_poll(), and
+// void *arg which is passed to the callback.
+// This function returns the job, or NULL if the pool is full.
+rsa_job *rsa_async_encrypt(rsa_async *pool, mpz_t m, mpz_t e, mpz_t n, rsa_async_callback callback, void *arg) {
+    return submit(pool, OP_ENCRYPT, m, e, n, NULL, callback, arg);
+}
+
+// This function submits rsa_decrypt() of ciphertext c with private key d and modulus n, like
+// rsa_async_encrypt().
+// This function takes in as parameters rsa_async *pool, mpz_t c, mpz_t d, mpz_t n, rsa_async_callback callback,
+// and void *arg.
+// This function returns the job, or NULL if the pool is full.
+rsa_job *rsa_async_decrypt(rsa_async *pool, mpz_t c, mpz_t d, mpz_t n, rsa_async_callback callback, void *arg) {
+    return submit(pool, OP_DECRYPT, c, d, n, NULL, callback, arg);
+}
+
+// This function submits rsa_sign() of message m with private key d and modulus n, like rsa_async_encrypt().
+// This function takes in as parameters rsa_async *pool, mpz_t m, mpz_t d, mpz_t n, rsa_async_callback callback,
+// and void *arg.
+// This function returns the job, or NULL if the pool is full.
+rsa_job *rsa_async_sign(rsa_async *pool, mpz_t m, mpz_t d, mpz_t n, rsa_async_callback callback, void *arg) {
+    return submit(pool, OP_SIGN, m, d, n, NULL, callback, arg);
+}
+
+// This function submits rsa_verify() of signature s on message m with public exponent e and modulus n, like
+// rsa_async_encrypt(). The outcome is read with rsa_job_verified().
+// This function takes in as parameters rsa_async *pool, mpz_t m, mpz_t s, mpz_t e, mpz_t n,
+// rsa_async_callback callback, and void *arg.
+// This function returns the job, or NULL if the pool is full.
+rsa_job *rsa_async_verify(
+    rsa_async *pool, mpz_t m, mpz_t s, mpz_t e, mpz_t n, rsa_async_callback callback, void *arg) {
+    return submit(pool, OP_VERIFY, s, e, n, m, callback, arg);
+}
+
+// This function takes the next completed job without a callback, without blocking.
+// This function takes in as a parameter rsa_async *pool.
+// This function returns the job, which belongs to the caller until rsa_job_free(), or NULL if none is waiting.
+rsa_job *rsa_async_poll(rsa_async *pool) {
+    pthread_mutex_lock(&pool->completed.lock);
+    rsa_job *job = list_take(&pool->completed);
+    pthread_mutex_unlock(&pool->completed.lock);
+    return job;
+}
+
+// This function takes the next completed job without a callback, blocking until there is one.
+// This function takes in as a parameter rsa_async *pool.
+// This function returns the job, which belongs to the caller until rsa_job_free().
+rsa_job *rsa_async_wait(rsa_async *pool) {
+    pthread_mutex_lock(&pool->completed.lock);
+    rsa_job *job;
+    while ((job = list_take(&pool->completed)) == NULL) {
+        pthread_cond_wait(&pool->completion, &pool->completed.lock);
+    }
+    pthread_mutex_unlock(&pool->completed.lock);
+    return job;
+}
+
+// This function cancels a job that has not started running yet. A cancelled job is still delivered, to its
+// callback or through rsa_async_poll(), once a worker reaches it, which takes no bignum math.
+// This function takes in as a parameter rsa_job *job.
+// This function returns true if the job was cancelled, and false if it had already started.
+bool rsa_async_cancel(rsa_job *job) {
+    int queued = JOB_QUEUED;
+    return atomic_compare_exchange_strong(&job->state, &queued, JOB_CANCELLED);
+}
+
+// This function reports whether a job is still pending, completed, or was cancelled.
+// This function takes in as a parameter rsa_job *job.
+// This function returns the status.
+rsa_async_status rsa_job_status(rsa_job *job) {
+    switch (atomic_load(&job->state)) {
+    case JOB_DONE: return RSA_ASYNC_DONE;
+    case JOB_CANCELLED: return RSA_ASYNC_CANCELLED;
+    default: return RSA_ASYNC_PENDING;
+    }
+}
+
+// This function copies the ciphertext, message, or signature computed by a completed job to out.
+// This function takes in as parameters rsa_job *job and mpz_t out.
+void rsa_job_result(rsa_job *job, mpz_t out) {
+    mpz_set(out, job->result);
+}
+
+// This function reports the outcome of a completed verification job.
+// This function takes in as a parameter rsa_job *job.
+// This function returns true if the signature was verified.
+bool rsa_job_verified(rsa_job *job) {
+    return job->verified;
+}
+
+// This function returns the arg a job was submitted with.
+// This function takes in as a parameter rsa_job *job.
+void *rsa_job_arg(rsa_job *job) {
+    return job->arg;
+}
+
+// This function drops a reference to a job. Once the caller and, for a job with a callback, the pool have both
+// dropped theirs, the job is freed, making room for another job to be submitted.
+// This function takes in as a parameter rsa_job *job.
+void rsa_job_free(rsa_job *job) {
+    if (atomic_fetch_sub(&job->refs, 1) != 1) {
+        return;
+    }
+    atomic_fetch_sub(&job->pool->outstanding, 1);
+    mpz_clear(job->input);
+    mpz_clear(job->key);
+    mpz_clear(job->n);
+    mpz_clear(job->message);
+    mpz_clear(job->result);
+    free(job);
+}
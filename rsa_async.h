@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <gmp.h>
+
+typedef enum {
+    RSA_ASYNC_PENDING,
+    RSA_ASYNC_DONE,
+    RSA_ASYNC_CANCELLED
+} rsa_async_status;
+
+typedef struct rsa_async rsa_async;
+
+typedef struct rsa_job rsa_job;
+
+typedef void (*rsa_async_callback)(rsa_job *job, void *arg);
+
+rsa_async *rsa_async_create(size_t workers, size_t max_jobs);
+
+void rsa_async_destroy(rsa_async *pool);
+
+int rsa_async_fd(rsa_async *pool);
+
+// Every job returned by a submit function is freed with rsa_job_free() exactly once: a job without a callback
+// after rsa_async_poll() or rsa_async_wait() has returned it, and a job with a callback whenever the caller is
+// done with the handle. The pool keeps a job with a callback alive until the callback returns, and the
+// callback must not free it.
+rsa_job *rsa_async_encrypt(rsa_async *pool, mpz_t m, mpz_t e, mpz_t n, rsa_async_callback callback, void *arg);
+
+rsa_job *rsa_async_decrypt(rsa_async *pool, mpz_t c, mpz_t d, mpz_t n, rsa_async_callback callback, void *arg);
+
+rsa_job *rsa_async_sign(rsa_async *pool, mpz_t m, mpz_t d, mpz_t n, rsa_async_callback callback, void *arg);
+
+rsa_job *rsa_async_verify(
+    rsa_async *pool, mpz_t m, mpz_t s, mpz_t e, mpz_t n, rsa_async_callback callback, void *arg);
+
+rsa_job *rsa_async_poll(rsa_async *pool);
+
+rsa_job *rsa_async_wait(rsa_async *pool);
+
+bool rsa_async_cancel(rsa_job *job);
+
+rsa_async_status rsa_job_status(rsa_job *job);
+
+void rsa_job_result(rsa_job *job, mpz_t out);
+
+bool rsa_job_verified(rsa_job *job);
+
+void *rsa_job_arg(rsa_job *job);
+
+void rsa_job_free(rsa_job *job);
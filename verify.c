@@ -0,0 +1,189 @@
+#include "hex.h"
+#include "numtheory.h"
+#include "randstate.h"
+#include "rsa.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <gmp.h>
+
+#define OPTIONS "i:o:n:b:s:vh"
+
+void help_message(void) {
+    fprintf(stderr, "SYNOPSIS\n"
+                    "   Verifies RSA signatures made with one key, in batches.\n"
+                    "   The input holds a message and its signature on alternate lines, in hexadecimal.\n"
+                    "   A line of output says whether each signature is valid or invalid.\n"
+                    "\n"
+                    "USAGE\n"
+                    "   ./verify [-hv] [-i infile] [-o outfile] [-b batch] -n pubkey\n"
+                    "\n"
+                    "OPTIONS\n"
+                    "   -h              Display program help and usage.\n"
+                    "   -v              Display verbose program output.\n"
+                    "   -i infile       Input file of messages and signatures (default: stdin).\n"
+                    "   -o outfile      Output file for the results (default: stdout).\n"
+                    "   -n pbfile       Public key file (default: rsa.pub).\n"
+                    "   -b batch        Number of signatures screened together (default: 64).\n"
+                    "   -s seed         Random seed for testing (default: read from /dev/urandom).\n");
+}
+
+int main(int argc, char **argv) {
+    int opt = 0;
+    FILE *infile = stdin;
+    FILE *outfile = stdout;
+    char *pbname = "rsa.pub";
+    FILE *pbfile;
+    size_t batch = 64;
+    uint64_t seed = 0;
+    bool verbose = false;
+
+    // Parsing command-line options using getopt() and handling them accordingly.
+    while ((opt = getopt(argc, argv, OPTIONS)) != -1) {
+        switch (opt) {
+        case 'i':
+            if ((infile = fopen(optarg, "r")) == NULL) {
+                fprintf(stderr, "%s: No such file or directory\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'o':
+            if ((outfile = fopen(optarg, "w")) == NULL) {
+                fprintf(stderr, "%s: No such file or directory\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'n': pbname = optarg; break;
+        case 'b':
+            if (atoi(optarg) > 0) {
+                batch = atoi(optarg);
+            }
+            break;
+        case 's':
+            if (atoi(optarg) != 0) {
+                seed = atoi(optarg);
+            }
+            break;
+        case 'v': verbose = true; break;
+        case 'h': help_message(); return EXIT_SUCCESS;
+        default: help_message(); return EXIT_FAILURE;
+        }
+    }
+
+    // Opening the public key file using fopen(). Printing a helpful error and exiting the program in the event
+    // of failure.
+    pbfile = fopen(pbname, "r");
+    if (pbfile == NULL) {
+        fprintf(stderr, "%s: No such file or directory\n", pbname);
+        return EXIT_FAILURE;
+    }
+
+    mpz_t n;
+    mpz_init(n);
+    mpz_t e;
+    mpz_init(e);
+    mpz_t s;
+    mpz_init(s);
+    char username[256];
+
+    // Reading the public key from the opened public key file.
+    rsa_read_pub(n, e, s, username, pbfile);
+    fclose(pbfile);
+
+    // If verbose output is enabled, print the username, the public modulus n, and the public exponent e each
+    // with a trailing newline.
+    if (verbose) {
+        printf("user = %s\n", username);
+        gmp_printf("n (%d bits) = %Zd\n", mpz_sizeinbase(n, 2), n);
+        gmp_printf("e (%d bits) = %Zd\n", mpz_sizeinbase(e, 2), e);
+    }
+
+    // Initializing the random state that picks the exponents of the batch test. Anyone who can predict the
+    // exponents can forge a pair of signatures that cancel out in the batch, so they are seeded from
+    // /dev/urandom unless a seed was given with -s for testing.
+    if (seed != 0) {
+        randstate_init(seed);
+    } else if (!randstate_init_urandom()) {
+        fprintf(stderr, "Error: failed to read /dev/urandom.\n");
+        return EXIT_FAILURE;
+    }
+
+    mpz_t *m = (mpz_t *) calloc(batch, sizeof(mpz_t));
+    mpz_t *signatures = (mpz_t *) calloc(batch, sizeof(mpz_t));
+    bool *valid = (bool *) calloc(batch, sizeof(bool));
+    for (size_t i = 0; i < batch; i++) {
+        mpz_init(m[i]);
+        mpz_init(signatures[i]);
+    }
+
+    // Reading the messages and signatures a batch at a time, screening each batch with rsa_verify_batch(), and
+    // writing out the result of every signature in order. A line that is not hexadecimal or a message without a
+    // signature fails the program, since the signatures after it would otherwise go unchecked.
+    size_t total = 0;
+    size_t invalid = 0;
+    size_t line = 0;
+    bool malformed = false;
+    bool more = true;
+    while (more) {
+        size_t count = 0;
+        while (count < batch && (more = hex_more(infile))) {
+            line++;
+            if (hex_read(infile, m[count]) == false) {
+                fprintf(stderr, "Error: line %zu is not a hexadecimal message.\n", line);
+                malformed = true;
+                break;
+            }
+            line++;
+            if (hex_more(infile) == false) {
+                fprintf(stderr, "Error: the message on line %zu has no signature.\n", line - 1);
+                malformed = true;
+                break;
+            }
+            if (hex_read(infile, signatures[count]) == false) {
+                fprintf(stderr, "Error: line %zu is not a hexadecimal signature.\n", line);
+                malformed = true;
+                break;
+            }
+            count++;
+        }
+        more = more && !malformed;
+        if (count > 0 && rsa_verify_batch(m, signatures, count, e, n, valid) == false) {
+            for (size_t i = 0; i < count; i++) {
+                invalid += valid[i] ? 0 : 1;
+            }
+        }
+        for (size_t i = 0; i < count; i++) {
+            fprintf(outfile, "%s\n", valid[i] ? "valid" : "invalid");
+        }
+        total += count;
+    }
+
+    if (verbose) {
+        printf("%zu of %zu signatures are invalid\n", invalid, total);
+    }
+
+    // Closing infile and outfile, and clearing the random state and all the mpz_t variables used in the program.
+    fclose(infile);
+    fclose(outfile);
+    randstate_clear();
+    for (size_t i = 0; i < batch; i++) {
+        mpz_clear(m[i]);
+        mpz_clear(signatures[i]);
+    }
+    free(m);
+    free(signatures);
+    free(valid);
+    mpz_clear(n);
+    mpz_clear(e);
+    mpz_clear(s);
+
+    return invalid == 0 && !malformed ? EXIT_SUCCESS : EXIT_FAILURE;
+}